@@ -0,0 +1,91 @@
+/**
+ * Thin hardware abstraction for the few places the firmware touches 32U4
+ * registers directly instead of going through the Arduino/Romi32U4 APIs.
+ * On the robot these are register writes, inline below or in src/HAL.cpp where
+ * an ISR is involved; the `native` environment (ROMI_SIM) implements them
+ * against the simulated plant in lib/RomiSim.
+ */
+
+#include <Arduino.h>
+
+#pragma once
+
+// Scheduler tick period. On the robot this is Timer 0's compare B interrupt, which
+// rides along with the Arduino millis() timer (F_CPU / 64 / 256 = 976.5625 Hz).
+const unsigned long HAL_TICK_MICROS = 1024;
+
+/**
+ * Start calling `fn` from interrupt context once every HAL_TICK_MICROS.
+ */
+void halStartTick(void (*fn)());
+
+// Most analog pins the background ADC sampler can cycle through
+const uint8_t HAL_ADC_MAX_CHANNELS = 4;
+
+/**
+ * Start converting `pins` round-robin in the background, one conversion per ADC
+ * interrupt (~104us each). analogRead() must not be used while it runs.
+ * @param pins Arduino analog pin numbers (e.g. 20, 21)
+ * @param count Number of pins, up to HAL_ADC_MAX_CHANNELS
+ */
+void halAdcStart(const uint8_t *pins, uint8_t count);
+
+/**
+ * Copy the newest complete round of conversions, all taken in the same pass.
+ * @param values Receives one 0 - 1023 reading per pin, in `halAdcStart()` order
+ * @return False until the first round has finished
+ */
+bool halAdcRead(uint16_t *values);
+
+// The 32U4's 2.5 KB of SRAM: .data and .bss at the bottom, then the heap, then
+// the stack growing down from the top. Everything above the heap is painted with
+// a known byte before main() runs, so the deepest the stack has ever been can be
+// read back later. Both return 0 in the simulator, which has no SRAM to measure.
+const uint16_t HAL_SRAM_BYTES = 2560;
+
+/**
+ * @return Bytes between the heap and the deepest stack use since reset (the
+ *         stack's headroom so far)
+ */
+uint16_t halStackUnused();
+
+/**
+ * @return Bytes between the heap and the stack pointer right now
+ */
+uint16_t halFreeRam();
+
+#ifdef ROMI_SIM
+
+void halLifterPWMSetup();
+void halLifterPWM(uint16_t duty);
+uint8_t halReadLifterEncoder();
+
+#else
+
+/**
+ * Timer 1 in phase-correct PWM with ICR1 as TOP (400 -> 20kHz), OC1C on pin 11.
+ */
+inline void halLifterPWMSetup() {
+    TCCR1A = 0xA8;
+    TCCR1B = 0x11;
+    ICR1 = 400;
+    OCR1C = 0;
+}
+
+/**
+ * Set the lifter PWM duty.
+ * @param duty 0 - 400
+ */
+inline void halLifterPWM(uint16_t duty) {
+    OCR1C = duty;
+}
+
+/**
+ * Read both lifter encoder channels at once. ENCA is pin 2 (PD1) and ENCB is
+ * pin 3 (PD0), so the low two bits of PIND are already (ENCA << 1) | ENCB.
+ */
+inline uint8_t halReadLifterEncoder() {
+    return PIND & 0x03;
+}
+
+#endif
@@ -0,0 +1,111 @@
+/**
+ * Host-side stand-in for the Arduino core, used by the `native` environment.
+ * Every call is routed into the simulated Romi plant (see RomiSim.h) and charges
+ * roughly what it costs on the 16 MHz 32U4, so busy-waits and delay() advance
+ * virtual time instead of wall-clock time.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <cmath>
+#include <cstdlib>
+
+#pragma once
+
+using std::abs;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#ifndef F_CPU
+#define F_CPU 16000000L
+#endif
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#define digitalPinToInterrupt(p) (p)
+
+// Flash and RAM are one address space on the host.
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_float(addr) (*(const float *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strcmp_P strcmp
+
+template <typename T, typename L, typename H>
+inline T constrain(T x, L lo, H hi) { return (x < lo) ? (T)lo : ((x > hi) ? (T)hi : x); }
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+void delayMicroseconds(unsigned int us);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void noInterrupts();
+void interrupts();
+inline void cli() { noInterrupts(); }
+inline void sei() { interrupts(); }
+
+/**
+ * Serial port model. Output goes through a 64-byte TX buffer that drains at the
+ * configured baud rate; once it is full, print() blocks exactly like the real
+ * USB/UART driver does, which is what makes chatty debug output show up in
+ * the loop timing.
+ */
+class SimSerial {
+    public:
+        void begin(unsigned long baud);
+        void end() {}
+        int available();
+        int read();
+        int peek();
+        void flush();
+        size_t write(uint8_t c);
+        size_t write(const uint8_t *buf, size_t len);
+        int availableForWrite();
+
+        size_t print(const char *s);
+        size_t print(char c);
+        size_t print(int n, int base = 10);
+        size_t print(unsigned int n, int base = 10);
+        size_t print(long n, int base = 10);
+        size_t print(unsigned long n, int base = 10);
+        size_t print(double n, int digits = 2);
+
+        size_t println();
+        template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+        template <typename T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+
+        operator bool() { return true; }
+};
+
+extern SimSerial Serial;
@@ -0,0 +1,31 @@
+/**
+ * Host-side stand-in for the Arduino AVR EEPROM library: the 32U4's 1 KB of
+ * EEPROM, erased (0xFF) at start unless the simulator was given a file to keep
+ * it in (--eeprom). Writes charge the 3.4 ms the real cell takes.
+ */
+
+#include <Arduino.h>
+
+#pragma once
+
+class EEPROMClass {
+    public:
+        uint8_t read(int idx);
+        void write(int idx, uint8_t val);
+        void update(int idx, uint8_t val);
+        uint16_t length() { return 1024; }
+
+        template <typename T> T &get(int idx, T &t) {
+            uint8_t *p = (uint8_t *)&t;
+            for (size_t i = 0; i < sizeof(T); i++) p[i] = read(idx + i);
+            return t;
+        }
+
+        template <typename T> const T &put(int idx, const T &t) {
+            const uint8_t *p = (const uint8_t *)&t;
+            for (size_t i = 0; i < sizeof(T); i++) update(idx + i, p[i]);
+            return t;
+        }
+};
+
+extern EEPROMClass EEPROM;
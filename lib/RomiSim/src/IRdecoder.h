@@ -0,0 +1,14 @@
+/**
+ * Host-side stand-in for the wpi-32u4-library IR remote decoder. Key presses
+ * come from the simulator's scripted key schedule (RomiSim::scheduleKey()).
+ */
+
+#include <Arduino.h>
+
+#pragma once
+
+class IRDecoder {
+    public:
+        void init() {}
+        int16_t getKeyCode(bool acknowledge = true);
+};
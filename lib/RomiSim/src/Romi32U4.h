@@ -0,0 +1,57 @@
+/**
+ * Host-side stand-in for the parts of the Pololu Romi32U4 library that the
+ * robot uses. Motors and encoders are backed by the simulated drivetrain.
+ */
+
+#include <Arduino.h>
+
+#pragma once
+
+class Romi32U4Motors {
+    public:
+        static void flipLeftMotor(bool flip) { (void)flip; }
+        static void flipRightMotor(bool flip) { (void)flip; }
+        static void setLeftEffort(int16_t effort);
+        static void setRightEffort(int16_t effort);
+        static void setEfforts(int16_t leftEffort, int16_t rightEffort);
+        static void allowTurbo(bool turbo) { (void)turbo; }
+};
+
+class Romi32U4Encoders {
+    public:
+        static void init() {}
+        static int16_t getCountsLeft();
+        static int16_t getCountsRight();
+        static int16_t getCountsAndResetLeft();
+        static int16_t getCountsAndResetRight();
+        static bool checkErrorLeft() { return false; }
+        static bool checkErrorRight() { return false; }
+};
+
+/**
+ * Push buttons read as pressed once the simulated operator has "pressed start"
+ * (RomiSim::Config::startPressMs), so `while(!pushButton.isPressed())` in setup()
+ * falls through on its own.
+ */
+class Romi32U4ButtonA {
+    public:
+        bool isPressed();
+        bool getSingleDebouncedPress() { return isPressed(); }
+};
+
+class Romi32U4ButtonB {
+    public:
+        bool isPressed() { return false; }
+        bool getSingleDebouncedPress() { return false; }
+};
+
+class Romi32U4ButtonC {
+    public:
+        bool isPressed() { return false; }
+        bool getSingleDebouncedPress() { return false; }
+};
+
+inline void ledRed(bool on) { (void)on; }
+inline void ledGreen(bool on) { (void)on; }
+inline void ledYellow(bool on) { (void)on; }
+inline uint16_t readBatteryMillivolts() { return 7200; }
@@ -0,0 +1,599 @@
+#include <stdio.h>
+#include "RomiSim.h"
+
+RomiSim romiSim;
+
+static const uint64_t SUBSTEP_US = 1000;        // Longest plant integration step; shorter charges are batched up to it
+static const uint8_t LIFTER_AIN1 = 13;
+static const uint8_t LIFTER_AIN2 = 4;
+static const uint8_t LIFTER_ENCA = 2;
+static const uint8_t LIFTER_ENCB = 3;
+static const uint8_t RANGE_TRIGGER = 12;
+static const uint8_t RANGE_ECHO = 0;
+static const uint8_t LINE_LEFT = 20;
+static const uint8_t LINE_RIGHT = 21;
+static const int LIFTER_CPR = 540;
+static const float LIFTER_GEAR_RATIO = 30.8;
+static const float TAPE_HALF_WIDTH = 0.375;     // 3/4" electrical tape
+static const float TAPE_BLUR = 0.15;            // Sensor footprint, inches
+static const int LINE_ON_TAPE = 950;
+static const int LINE_OFF_TAPE = 45;
+
+// Quadrature state presented on (ENCA << 1) | ENCB for increasing count.
+static const uint8_t QUAD_SEQUENCE[4] = {0, 1, 3, 2};
+
+static float sign(float v) { return (v > 0) - (v < 0); }
+
+/**
+ * Reset the plant and lay out the field for the configured mission.
+ * @param c Plant and field configuration
+ */
+void RomiSim::begin(const Config &c) {
+    *this = RomiSim();
+    cfg = c;
+    if (cfg.baud) baud = cfg.baud;
+    rngState = cfg.seed ? cfg.seed : 1;
+
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    if (cfg.eepromFile) {
+        FILE *f = fopen(cfg.eepromFile, "rb");
+        if (f) {
+            size_t n = fread(eeprom, 1, sizeof(eeprom), f);
+            (void)n;
+            fclose(f);
+        }
+    }
+
+    // Per-run scatter for regression sweeps: where the robot was set down, motor
+    // and battery spread, and payload weight. Each term is about one typical
+    // tolerance at variation 1.
+    if (cfg.variation > 0) {
+        robot.x += scatter(0.25);
+        robot.y += scatter(0.25);
+        robot.heading += scatter(2.0) * PI / 180.0;
+        cfg.leftGain *= 1.0 + scatter(0.04);
+        cfg.rightGain *= 1.0 + scatter(0.04);
+        cfg.wheelDeadband *= 1.0 + scatter(0.2);
+        cfg.lifterMaxCountsPerSec *= 1.0 + scatter(0.08);
+        cfg.lifterFriction *= 1.0 + scatter(0.15);
+        cfg.lifterGravity *= 1.0 + scatter(0.25);
+    }
+    loadField();
+}
+
+/**
+ * Spend `us` microseconds of CPU time. Inside an ISR or a critical section the
+ * time is banked and paid once interrupts are back on, so interrupts never nest.
+ * @param us Microseconds to advance
+ */
+void RomiSim::charge(unsigned long us) {
+    if (inIsr || !interruptsOn) {
+        debt += us;
+        return;
+    }
+    uint64_t total = debt + us;
+    debt = 0;
+    advance(total);
+}
+
+void RomiSim::setInterruptsEnabled(bool enabled) {
+    interruptsOn = enabled;
+    if (enabled && !inIsr && debt) charge(0);
+}
+
+void RomiSim::pinWrite(uint8_t pin, uint8_t val) {
+    if (pin >= 32) return;
+    if (pin == LIFTER_AIN1 || pin == LIFTER_AIN2) syncPlant();
+    uint8_t old = pins[pin];
+    pins[pin] = val ? HIGH : LOW;
+
+    if (pin == RANGE_TRIGGER) {
+        if (!old && val) trigHighAt = now;
+        if (old && !val && now - trigHighAt >= 10) ping();
+    }
+}
+
+int RomiSim::pinRead(uint8_t pin) {
+    return (pin < 32) ? pins[pin] : LOW;
+}
+
+/**
+ * Reflectance reading for a line sensor, 0 - 1023, high over black tape. A
+ * `lineGlitchRate` fraction of readings instead catch a scuff or a shadow and
+ * read as tape.
+ */
+int RomiSim::analog(uint8_t pin) {
+    if (pin != LINE_LEFT && pin != LINE_RIGHT) return 0;
+    if (cfg.lineGlitchRate > 0 && random() < cfg.lineGlitchRate) return LINE_ON_TAPE;
+
+    const float forward = 2.0;
+    const float lateral = (pin == LINE_LEFT) ? 0.4 : -0.4;
+    float c = cos(robot.heading);
+    float s = sin(robot.heading);
+    float x = robot.x + forward * c - lateral * s;
+    float y = robot.y + forward * s + lateral * c;
+
+    float cover = (TAPE_HALF_WIDTH + TAPE_BLUR - tapeDistance(x, y)) / (2 * TAPE_BLUR);
+    cover = constrain(cover, 0.0f, 1.0f);
+    return LINE_OFF_TAPE + (int)(cover * (LINE_ON_TAPE - LINE_OFF_TAPE));
+}
+
+void RomiSim::attach(uint8_t pin, void (*fn)()) {
+    if (pin < 32) isrs[pin] = fn;
+}
+
+void RomiSim::detach(uint8_t pin) {
+    if (pin < 32) isrs[pin] = 0;
+}
+
+/**
+ * Call `fn` from interrupt context every `periodUs`, like a timer compare interrupt.
+ */
+void RomiSim::attachTick(void (*fn)(), unsigned long periodUs) {
+    tickFn = fn;
+    tickPeriod = periodUs;
+    nextTick = now + periodUs;
+}
+
+void RomiSim::setChassisEfforts(int16_t left, int16_t right) {
+    setLeftEffort(left);
+    setRightEffort(right);
+}
+
+void RomiSim::setLeftEffort(int16_t effort) {
+    syncPlant();
+    leftEffort = constrain(effort, -300, 300);
+    checkStop();
+}
+
+void RomiSim::setRightEffort(int16_t effort) {
+    syncPlant();
+    rightEffort = constrain(effort, -300, 300);
+    checkStop();
+}
+
+void RomiSim::setLifterDuty(uint16_t duty) {
+    syncPlant();
+    lifterDuty = (duty > 400) ? 400 : duty;
+    checkStop();
+}
+
+void RomiSim::setGripper(int microseconds) {
+    gripperUS = microseconds;
+}
+
+int16_t RomiSim::leftCounts(bool reset) {
+    long c = (long)floor(leftPos) - leftZero;
+    if (reset) leftZero += c;
+    return (int16_t)c;
+}
+
+int16_t RomiSim::rightCounts(bool reset) {
+    long c = (long)floor(rightPos) - rightZero;
+    if (reset) rightZero += c;
+    return (int16_t)c;
+}
+
+bool RomiSim::startPressed() {
+    return now / 1000 >= cfg.startPressMs;
+}
+
+/**
+ * Press a remote key at a virtual time. While held the key repeats every
+ * KEY_REPEAT_MS, as the decoder reports NEC repeat frames as the last code.
+ * @param holdMs How long the key stays down; 0 for a single frame
+ */
+void RomiSim::scheduleKey(unsigned long ms, uint8_t code, unsigned long holdMs) {
+    if (keyCount >= MAX_KEYS) return;
+    keyTimes[keyCount] = ms;
+    keyCodes[keyCount] = code;
+    keyHolds[keyCount] = holdMs;
+    keyCount++;
+    if (code == cfg.stopKey && !stopKeyAt) stopKeyAt = (uint64_t)ms * 1000;
+}
+
+/**
+ * @param acknowledge False to look at the pending key without consuming it
+ * @return Key code, or -1 if none is pending
+ */
+int16_t RomiSim::popKey(bool acknowledge) {
+    if (keyNext < keyCount && now / 1000 >= keyTimes[keyNext]) {
+        if (!acknowledge) return keyCodes[keyNext];
+        repeatCode = keyHolds[keyNext] ? keyCodes[keyNext] : -1;
+        repeatNext = (uint64_t)(keyTimes[keyNext] + KEY_REPEAT_MS) * 1000;
+        repeatEnd = (uint64_t)(keyTimes[keyNext] + keyHolds[keyNext]) * 1000;
+        return keyCodes[keyNext++];
+    }
+    if (repeatCode >= 0 && now >= repeatEnd) repeatCode = -1;
+    if (repeatCode >= 0 && now >= repeatNext) {
+        if (acknowledge) repeatNext += (uint64_t)KEY_REPEAT_MS * 1000;
+        return repeatCode;
+    }
+    return -1;
+}
+
+/**
+ * Serial.begin(): adopt the firmware's baud rate unless the command line forced one.
+ */
+void RomiSim::serialBegin(unsigned long rate) {
+    if (!cfg.baud && rate) baud = rate;
+}
+
+/**
+ * Queue one byte for transmission, blocking (in virtual time) while the TX
+ * buffer is full. Like USB_Send() on the robot, the wait calls yield(), so a
+ * yield() hook in the firmware runs here too. Completed lines are checked
+ * against the stop marker.
+ */
+void RomiSim::serialWrite(uint8_t c) {
+    const float charTime = 10.0e6 / baud;
+    while (txQueued >= 64 && interruptsOn && !inIsr) {
+        charge((unsigned long)charTime);
+        yield();
+    }
+    if (txQueued < 64) txQueued += 1;
+    if (cfg.capture) fputc(c, cfg.capture);
+
+    if (c == '\n' || lineLen == (int)sizeof(lineBuf) - 1) {
+        lineBuf[lineLen] = 0;
+        if (cfg.echoSerial) printf("[%9.3f] %s\n", now / 1.0e6, lineBuf);
+        if (marker[0] && strstr(lineBuf, marker)) markerSeen = true;
+        lineLen = 0;
+    } else if (c != '\r') {
+        lineBuf[lineLen++] = c;
+    }
+}
+
+/**
+ * Type `text` and a newline into the serial monitor at a virtual time
+ */
+void RomiSim::scheduleInput(unsigned long ms, const char *text) {
+    if (inputCount >= MAX_INPUTS) return;
+    inputTimes[inputCount] = ms;
+    inputTexts[inputCount] = text;
+    inputCount++;
+}
+
+int RomiSim::serialAvailable() {
+    deliverInput();
+    return (rxHead - rxTail + (int)sizeof(rxBuf)) % (int)sizeof(rxBuf);
+}
+
+int RomiSim::serialRead() {
+    deliverInput();
+    if (rxHead == rxTail) return -1;
+    int c = (uint8_t)rxBuf[rxTail];
+    rxTail = (rxTail + 1) % sizeof(rxBuf);
+    return c;
+}
+
+int RomiSim::serialPeek() {
+    return (rxHead == rxTail) ? -1 : (uint8_t)rxBuf[rxTail];
+}
+
+void RomiSim::serialFlush() {
+    const float charTime = 10.0e6 / baud;
+    while (txQueued > 0 && interruptsOn && !inIsr) charge((unsigned long)charTime);
+}
+
+int RomiSim::serialFree() {
+    return 64 - (int)ceil(txQueued);
+}
+
+/**
+ * Push text into the simulated serial receive buffer, as if typed in the monitor.
+ */
+void RomiSim::serialInput(const char *text) {
+    for (; *text; text++) {
+        int next = (rxHead + 1) % sizeof(rxBuf);
+        if (next == rxTail) return;
+        rxBuf[rxHead] = *text;
+        rxHead = next;
+    }
+}
+
+uint8_t RomiSim::eepromRead(int idx) {
+    return (idx >= 0 && idx < EEPROM_SIZE) ? eeprom[idx] : 0xFF;
+}
+
+void RomiSim::eepromWrite(int idx, uint8_t val) {
+    if (idx >= 0 && idx < EEPROM_SIZE) eeprom[idx] = val;
+}
+
+/**
+ * Write the EEPROM back to Config::eepromFile, if there is one
+ */
+bool RomiSim::saveEeprom() {
+    if (!cfg.eepromFile) return true;
+    FILE *f = fopen(cfg.eepromFile, "wb");
+    if (!f) return false;
+    bool ok = fwrite(eeprom, 1, sizeof(eeprom), f) == sizeof(eeprom);
+    fclose(f);
+    return ok;
+}
+
+void RomiSim::setStopMarker(const char *m) {
+    strncpy(marker, m, sizeof(marker) - 1);
+    markerSeen = false;
+}
+
+float RomiSim::lifterMotorDegrees() const {
+    return lifterPos / LIFTER_CPR * 360.0;
+}
+
+float RomiSim::lifterArmDegrees() const {
+    return lifterMotorDegrees() / LIFTER_GEAR_RATIO;
+}
+
+/**
+ * True distance from the ultrasonic sensor to the first wall along its axis.
+ */
+float RomiSim::rangeTruthInches() const {
+    float x = robot.x + cfg.rangeOffset * cos(robot.heading);
+    float y = robot.y + cfg.rangeOffset * sin(robot.heading);
+    return castRay(x, y, robot.heading);
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+/**
+ * Step the plant forward, firing echo and encoder interrupts as they come due.
+ * The firmware charges a few microseconds at a time while it idles between
+ * scheduler ticks, so the plant is only integrated once SUBSTEP_US has built up
+ * (or a timed event is due). Sensors therefore lag the plant by under SUBSTEP_US,
+ * which is what keeps a full mission at a few hundred times real time.
+ */
+void RomiSim::advance(uint64_t us) {
+    uint64_t target = now + us;
+
+    while (true) {
+        if (echoPending && !pins[RANGE_ECHO] && now >= echoRiseAt) {
+            pins[RANGE_ECHO] = HIGH;
+            fireIsr(RANGE_ECHO);
+        }
+        if (echoPending && pins[RANGE_ECHO] && now >= echoFallAt) {
+            pins[RANGE_ECHO] = LOW;
+            echoPending = false;
+            fireIsr(RANGE_ECHO);
+        }
+        if (tickFn && now >= nextTick) {
+            nextTick += tickPeriod;
+            runIsr(tickFn);
+        }
+        checkStop();
+        if (now >= target) break;
+
+        uint64_t next = plantTime + SUBSTEP_US;
+        if (next > target) next = target;
+        if (echoPending) {
+            uint64_t ev = pins[RANGE_ECHO] ? echoFallAt : echoRiseAt;
+            if (ev > now && ev < next) next = ev;
+        }
+        if (tickFn && nextTick > now && nextTick < next) next = nextTick;
+
+        now = next;
+        if (now - plantTime >= SUBSTEP_US) syncPlant();
+    }
+}
+
+/**
+ * Bring the plant up to `now`, e.g. before an actuator changes, so a new effort
+ * never applies to time that has already passed. Waits for advance() instead
+ * if interrupts are off, since encoder edges must be able to interrupt.
+ */
+void RomiSim::syncPlant() {
+    if (inIsr || !interruptsOn || now == plantTime) return;
+    step(plantTime, now);
+    plantTime = now;
+}
+
+/**
+ * Integrate the plant from `from` to `to`. `now` is already `to`.
+ */
+void RomiSim::step(uint64_t from, uint64_t to) {
+    float dt = (to - from) * 1.0e-6;
+
+    // Drivetrain: first-order wheel speed response with a deadband.
+    const float span = 300 - cfg.wheelDeadband;
+    float leftTarget = sign(leftEffort) * fmax(0, abs(leftEffort) - cfg.wheelDeadband) / span
+                        * cfg.wheelMaxCountsPerSec * cfg.leftGain;
+    float rightTarget = sign(rightEffort) * fmax(0, abs(rightEffort) - cfg.wheelDeadband) / span
+                        * cfg.wheelMaxCountsPerSec * cfg.rightGain;
+    leftRate += (leftTarget - leftRate) * fmin(1.0f, dt / cfg.wheelTau);
+    rightRate += (rightTarget - rightRate) * fmin(1.0f, dt / cfg.wheelTau);
+
+    float dl = leftRate * dt;
+    float dr = rightRate * dt;
+    leftPos += dl;
+    rightPos += dr;
+
+    const float inchesPerCount = PI * cfg.wheelDiameter / cfg.wheelCPR;
+    float v = (dl + dr) * 0.5 * inchesPerCount;
+    float dTheta = (dr - dl) * inchesPerCount / cfg.wheelTrack;
+    robot.x += v * cos(robot.heading + dTheta * 0.5);
+    robot.y += v * sin(robot.heading + dTheta * 0.5);
+    robot.heading += dTheta;
+
+    // Lifter: AIN1 high drives the count up (arm down), AIN2 high drives it down (arm up).
+    // Gravity always pulls the arm down; the gearbox holds until friction is overcome.
+    float u = 0;
+    if (pins[LIFTER_AIN1] && !pins[LIFTER_AIN2]) u = lifterDuty / 400.0;
+    else if (!pins[LIFTER_AIN1] && pins[LIFTER_AIN2]) u = -lifterDuty / 400.0;
+    float armFromHorizontal = (-lifterArmDegrees() - 20.0) * PI / 180.0;
+    u += cfg.lifterGravity * cos(armFromHorizontal);
+
+    float lifterTarget = 0;
+    if (fabs(u) > cfg.lifterFriction) {
+        lifterTarget = sign(u) * (fabs(u) - cfg.lifterFriction) / (1.0 - cfg.lifterFriction)
+                        * cfg.lifterMaxCountsPerSec;
+    }
+    lifterRate += (lifterTarget - lifterRate) * fmin(1.0f, dt / cfg.lifterTau);
+    float lifterStart = lifterPos;
+    lifterPos += lifterRate * dt;
+    stepLifterEncoder(lifterStart, from, to);
+
+    // Serial TX drains at the line rate.
+    txQueued = fmax(0, txQueued - dt * baud / 10.0);
+}
+
+/**
+ * Present every quadrature edge between the last reported count and the plant
+ * position on ENCA/ENCB, interrupting once per edge like the real encoder. Each
+ * interrupt sees micros() at the moment the plant crossed that edge, interpolated
+ * across the step, so edge timing stays exact however long the step was.
+ * @param startPos Plant position at `from`
+ */
+void RomiSim::stepLifterEncoder(float startPos, uint64_t from, uint64_t to) {
+    long target = (long)floor(lifterPos);
+    float travel = lifterPos - startPos;
+    uint64_t stepEnd = now;
+    while (lifterEdge != target) {
+        bool up = target > lifterEdge;
+        float crossing = up ? lifterEdge + 1 : lifterEdge;
+        float fraction = (travel != 0) ? (crossing - startPos) / travel : 1.0;
+        now = from + (uint64_t)(constrain(fraction, 0.0f, 1.0f) * (to - from));
+
+        uint8_t before = QUAD_SEQUENCE[lifterEdge & 3];
+        lifterEdge += up ? 1 : -1;
+        uint8_t after = QUAD_SEQUENCE[lifterEdge & 3];
+
+        pins[LIFTER_ENCA] = (after >> 1) & 1;
+        pins[LIFTER_ENCB] = after & 1;
+        fireIsr(((before ^ after) & 2) ? LIFTER_ENCA : LIFTER_ENCB);
+    }
+    now = stepEnd;
+}
+
+void RomiSim::fireIsr(uint8_t pin) {
+    if (isrs[pin]) runIsr(isrs[pin]);
+}
+
+void RomiSim::runIsr(void (*fn)()) {
+    if (inIsr || !interruptsOn) return;
+    inIsr = true;
+    fn();
+    inIsr = false;
+}
+
+/**
+ * Start an HC-SR04 measurement: echo goes high once the burst is out and stays
+ * high for the round trip, or for the 38 ms timeout when nothing answers. A
+ * `rangeGlitchRate` fraction of pings instead catch a stray reflection from
+ * somewhere closer, or lose the echo entirely.
+ */
+void RomiSim::ping() {
+    if (echoPending) return;
+    float d = rangeTruthInches();
+    if (random() < cfg.rangeGlitchRate) d = (random() < 0.5) ? d * random() : 1000.0;
+    float roundTrip = (d < 157.0) ? (2.0 * d * 2.54 / 0.0343) : 38000.0;
+    echoRiseAt = now + 450;
+    echoFallAt = echoRiseAt + (uint64_t)roundTrip;
+    echoPending = true;
+}
+
+/**
+ * Time the E-stop: the first moment after the stop key at which no motor is driven
+ */
+void RomiSim::checkStop() {
+    if (!stopKeyAt || restartUs >= 0 || now < stopKeyAt) return;
+    bool stopped = leftEffort == 0 && rightEffort == 0 && lifterDuty == 0;
+    if (stopLatencyUs < 0 && stopped) stopLatencyUs = now - stopKeyAt;
+    else if (stopLatencyUs >= 0 && !stopped) restartUs = now - stopKeyAt;
+}
+
+/**
+ * Move scheduled serial input that has come due into the receive buffer
+ */
+void RomiSim::deliverInput() {
+    while (inputNext < inputCount && now / 1000 >= inputTimes[inputNext]) {
+        serialInput(inputTexts[inputNext++]);
+        serialInput("\n");
+    }
+}
+
+/**
+ * Deterministic uniform random number in [0, 1), so runs are repeatable.
+ */
+float RomiSim::random() {
+    rngState = rngState * 1664525u + 1013904223u;
+    return (rngState >> 8) / 16777216.0f;
+}
+
+/**
+ * Uniform random offset in [-spread, spread), scaled by the configured variation
+ */
+float RomiSim::scatter(float spread) {
+    return (random() * 2.0 - 1.0) * spread * cfg.variation;
+}
+
+/**
+ * Field geometry, with the robot starting at the origin facing +x, ultrasonic
+ * sensor 4" from the roof's inner panel and wheels on the roof-side tape.
+ */
+void RomiSim::loadField() {
+    const float roofX = cfg.rangeOffset + 4.0;
+    wallCount = 0;
+    tapeCount = 0;
+
+    walls[wallCount++] = {roofX, -8, roofX, 8};                 // Roof inner panel
+    walls[wallCount++] = {-48, -48, 48, -48};                   // Field border
+    walls[wallCount++] = {48, -48, 48, 48};
+    walls[wallCount++] = {48, 48, -48, 48};
+    walls[wallCount++] = {-48, 48, -48, -48};
+
+    float crossX;
+    if (cfg.mission == 2) {
+        // 45-degree roof: platform is to the robot's right, further from the crossing.
+        crossX = roofX - cfg.rangeOffset - (13.45 - 3.0 + 2.35);
+        float platformY = -(cfg.rangeOffset + 13.75 - 2.0 + 6.5);
+        walls[wallCount++] = {crossX - 8, platformY, crossX + 8, platformY};
+    } else {
+        // 25-degree roof: platform is to the robot's left.
+        crossX = roofX - cfg.rangeOffset - (13.45 - 3.0);
+        float platformY = cfg.rangeOffset + 13.75 - 2.0;
+        walls[wallCount++] = {crossX - 8, platformY, crossX + 8, platformY};
+    }
+
+    tape[tapeCount++] = {-40, 0, roofX, 0};
+    tape[tapeCount++] = {crossX, -40, crossX, 40};
+}
+
+/**
+ * Distance along a ray to the nearest wall, or a large value if none is hit.
+ */
+float RomiSim::castRay(float x, float y, float heading) const {
+    float dx = cos(heading);
+    float dy = sin(heading);
+    float best = 1.0e6;
+
+    for (int i = 0; i < wallCount; i++) {
+        const SimSegment &w = walls[i];
+        float ex = w.x2 - w.x1;
+        float ey = w.y2 - w.y1;
+        float denom = dx * ey - dy * ex;
+        if (fabs(denom) < 1e-6) continue;
+        float t = ((w.x1 - x) * ey - (w.y1 - y) * ex) / denom;
+        float u = ((w.x1 - x) * dy - (w.y1 - y) * dx) / denom;
+        if (t > 0 && u >= 0 && u <= 1 && t < best) best = t;
+    }
+    return best;
+}
+
+/**
+ * Distance from a point to the nearest tape centerline.
+ */
+float RomiSim::tapeDistance(float x, float y) const {
+    float best = 1.0e6;
+    for (int i = 0; i < tapeCount; i++) {
+        const SimSegment &s = tape[i];
+        float ex = s.x2 - s.x1;
+        float ey = s.y2 - s.y1;
+        float len2 = ex * ex + ey * ey;
+        float t = (len2 > 0) ? ((x - s.x1) * ex + (y - s.y1) * ey) / len2 : 0;
+        t = constrain(t, 0.0f, 1.0f);
+        float px = s.x1 + t * ex - x;
+        float py = s.y1 + t * ey - y;
+        best = fmin(best, sqrt(px * px + py * py));
+    }
+    return best;
+}
@@ -0,0 +1,216 @@
+/**
+ * Simulated Romi plant for the `native` environment: drivetrain, BlueMotor lifter,
+ * gripper servo, ultrasonic rangefinder and the two line sensors, all stepped
+ * against a virtual clock.
+ *
+ * Time only moves when the firmware "spends" it (delay(), a digitalRead(), a
+ * blocked Serial.print(), one pass through loop()...), so the firmware runs as
+ * fast as the host can execute it while still seeing a consistent plant.
+ */
+
+#include <stdio.h>
+#include <Arduino.h>
+
+#pragma once
+
+struct SimPose {
+    float x = 0;        // Inches, field frame
+    float y = 0;        // Inches, field frame
+    float heading = 0;  // Radians, CCW positive, 0 = facing +x
+};
+
+struct SimSegment {
+    float x1, y1, x2, y2;
+};
+
+class RomiSim {
+    public:
+        struct Config {
+            int mission = 1;                     // Field layout: 1 = 25-degree roof, 2 = 45-degree roof
+            unsigned long startPressMs = 500;    // When the operator presses button A
+            uint8_t stopKey = 0x01;              // Remote E-stop key (remotePlayPause), for stopLatency()
+            unsigned long baud = 0;              // Serial drain rate; 0 follows Serial.begin()
+            FILE *capture = 0;                   // Raw copy of every byte the firmware transmits
+            bool echoSerial = false;             // Mirror firmware Serial output to stdout
+            const char *eepromFile = 0;          // Keeps EEPROM contents between runs; 0 starts erased
+            uint32_t seed = 1;                   // Random stream for glitches and plant variation
+            float variation = 0;                 // Scale of the per-run plant scatter in begin(); 0 = nominal plant
+
+            // Drivetrain
+            float wheelMaxCountsPerSec = 3600;   // Wheel encoder rate at effort 300
+            float wheelDeadband = 15;            // Effort below which the wheels do not turn
+            float leftGain = 1.04;               // Left/right motor mismatch
+            float rightGain = 1.0;
+            float wheelTau = 0.05;               // Wheel speed time constant, s
+            float wheelDiameter = 2.8;           // Inches
+            float wheelTrack = 5.75;             // Inches
+            float wheelCPR = 1440;               // Encoder counts per wheel revolution
+            float rangeOffset = 3.0;             // Ultrasonic sensor ahead of the axle, inches
+            float rangeGlitchRate = 0.03;        // Fraction of pings that get a stray short echo or none at all
+            float lineGlitchRate = 0;            // Fraction of line sensor readings that see black where there is none
+
+            // Lifter
+            float lifterMaxCountsPerSec = 1100;  // Motor shaft encoder rate at full duty
+            float lifterFriction = 0.22;         // Duty fraction needed to break the gearbox loose
+            float lifterGravity = 0.10;          // Duty fraction gravity contributes at horizontal
+            float lifterTau = 0.04;              // Lifter speed time constant, s
+        };
+
+        void begin(const Config &c);
+        const Config &config() const { return cfg; }
+
+        // ----- Virtual time ----- //
+        void charge(unsigned long us);
+        uint64_t nowMicros() const { return now; }
+        void setInterruptsEnabled(bool enabled);
+
+        // ----- Pins ----- //
+        void pinWrite(uint8_t pin, uint8_t val);
+        int pinRead(uint8_t pin);
+        int analog(uint8_t pin);
+        void attach(uint8_t pin, void (*fn)());
+        void detach(uint8_t pin);
+        void attachTick(void (*fn)(), unsigned long periodUs);
+
+        // ----- Actuators ----- //
+        void setChassisEfforts(int16_t left, int16_t right);
+        void setLeftEffort(int16_t effort);
+        void setRightEffort(int16_t effort);
+        void setLifterDuty(uint16_t duty);
+        void setGripper(int microseconds);
+
+        // ----- Sensors ----- //
+        int16_t leftCounts(bool reset);
+        int16_t rightCounts(bool reset);
+        bool startPressed();
+        void scheduleKey(unsigned long ms, uint8_t code, unsigned long holdMs = 0);
+        int16_t popKey(bool acknowledge = true);
+
+        // ----- Serial ----- //
+        void serialBegin(unsigned long baud);
+        void serialWrite(uint8_t c);
+        int serialAvailable();
+        int serialRead();
+        int serialPeek();
+        void serialFlush();
+        int serialFree();
+        void serialInput(const char *text);
+        void scheduleInput(unsigned long ms, const char *text);
+        void setStopMarker(const char *marker);
+        bool stopMarkerSeen() const { return markerSeen; }
+
+        // ----- EEPROM ----- //
+        uint8_t eepromRead(int idx);
+        void eepromWrite(int idx, uint8_t val);
+        bool saveEeprom();
+
+        // ----- Truth, for reporting ----- //
+        SimPose pose() const { return robot; }
+        float lifterArmDegrees() const;
+        float lifterMotorDegrees() const;
+        int gripperMicros() const { return gripperUS; }
+        float rangeTruthInches() const;
+        long stopLatency() const { return stopLatencyUs; }
+        long restartAfterStop() const { return restartUs; }
+
+    private:
+        void advance(uint64_t us);
+        void syncPlant();
+        void step(uint64_t from, uint64_t to);
+        void stepLifterEncoder(float startPos, uint64_t from, uint64_t to);
+        void fireIsr(uint8_t pin);
+        void runIsr(void (*fn)());
+        void ping();
+        void checkStop();
+        void deliverInput();
+        float random();
+        float scatter(float spread);
+        void loadField();
+        float castRay(float x, float y, float heading) const;
+        float tapeDistance(float x, float y) const;
+
+        Config cfg;
+        uint64_t now = 0;
+        uint64_t plantTime = 0;     // How far the plant has been integrated; trails `now` by < SUBSTEP_US
+        uint64_t debt = 0;
+        bool interruptsOn = true;
+        bool inIsr = false;
+
+        uint8_t pins[32] = {0};
+        void (*isrs[32])() = {0};
+        void (*tickFn)() = 0;
+        uint64_t tickPeriod = 0;
+        uint64_t nextTick = 0;
+
+        // Drivetrain
+        SimPose robot;
+        int16_t leftEffort = 0;
+        int16_t rightEffort = 0;
+        float leftRate = 0;     // counts/s
+        float rightRate = 0;
+        float leftPos = 0;      // counts
+        float rightPos = 0;
+        long leftZero = 0;
+        long rightZero = 0;
+
+        // Lifter
+        uint16_t lifterDuty = 0;
+        float lifterRate = 0;   // counts/s
+        float lifterPos = 0;    // counts
+        long lifterEdge = 0;    // quadrature state last presented on the pins
+
+        // Gripper
+        int gripperUS = 0;
+
+        // Rangefinder
+        uint64_t trigHighAt = 0;
+        uint64_t echoRiseAt = 0;
+        uint64_t echoFallAt = 0;
+        bool echoPending = false;
+
+        // IR remote
+        static const int MAX_KEYS = 16;
+        unsigned long keyTimes[MAX_KEYS];
+        uint8_t keyCodes[MAX_KEYS];
+        unsigned long keyHolds[MAX_KEYS];   // How long each key is held down, ms
+        int keyCount = 0;
+        int keyNext = 0;
+        static const unsigned long KEY_REPEAT_MS = 108;    // NEC repeat frame period
+        int16_t repeatCode = -1;    // Key being held, or -1
+        uint64_t repeatNext = 0;    // When its next repeat frame decodes, us
+        uint64_t repeatEnd = 0;     // When it is released, us
+        uint64_t stopKeyAt = 0;     // First scheduled stop key, us; 0 for none
+        long stopLatencyUs = -1;    // From then until every motor output was zero
+        long restartUs = -1;        // From then until a motor was driven again
+
+        // Serial
+        float txQueued = 0;
+        uint32_t rngState = 1;
+        unsigned long baud = 9600;
+        char lineBuf[128];
+        int lineLen = 0;
+        char marker[64] = {0};
+        bool markerSeen = false;
+        char rxBuf[64];
+        int rxHead = 0;
+        int rxTail = 0;
+        static const int MAX_INPUTS = 8;
+        unsigned long inputTimes[MAX_INPUTS];
+        const char *inputTexts[MAX_INPUTS];
+        int inputCount = 0;
+        int inputNext = 0;
+
+        // EEPROM
+        static const int EEPROM_SIZE = 1024;
+        uint8_t eeprom[EEPROM_SIZE];
+
+        // Field
+        static const int MAX_WALLS = 12;
+        static const int MAX_TAPE = 6;
+        SimSegment walls[MAX_WALLS];
+        int wallCount = 0;
+        SimSegment tape[MAX_TAPE];
+        int tapeCount = 0;
+};
+
+extern RomiSim romiSim;
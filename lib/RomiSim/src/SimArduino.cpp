@@ -0,0 +1,278 @@
+/**
+ * Arduino core and Pololu/wpi library entry points for the native environment.
+ * The per-call charges approximate the 16 MHz 32U4 so virtual time tracks what
+ * the same code would spend on the robot.
+ */
+
+#include <stdio.h>
+#include <Arduino.h>
+#include <Romi32U4.h>
+#include <servo32u4.h>
+#include <IRdecoder.h>
+#include <EEPROM.h>
+#include <HAL.h>
+#include "RomiSim.h"
+
+SimSerial Serial;
+EEPROMClass EEPROM;
+
+// ----- Arduino core ----- //
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+    romiSim.charge(4);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    romiSim.pinWrite(pin, val);
+    romiSim.charge(5);
+}
+
+int digitalRead(uint8_t pin) {
+    romiSim.charge(4);
+    return romiSim.pinRead(pin);
+}
+
+int analogRead(uint8_t pin) {
+    romiSim.charge(112);
+    return romiSim.analog(pin);
+}
+
+unsigned long millis() {
+    romiSim.charge(2);
+    return romiSim.nowMicros() / 1000;
+}
+
+unsigned long micros() {
+    romiSim.charge(4);
+    return romiSim.nowMicros();
+}
+
+/**
+ * Like the AVR core, delay() keeps calling yield() while it waits.
+ */
+void delay(unsigned long ms) {
+    while (ms-- > 0) {
+        romiSim.charge(1000);
+        yield();
+    }
+}
+
+__attribute__((weak)) void yield() {}
+
+void delayMicroseconds(unsigned int us) {
+    romiSim.charge(us);
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(), int mode) {
+    (void)mode;
+    romiSim.attach(interruptNum, userFunc);
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+    romiSim.detach(interruptNum);
+}
+
+void noInterrupts() {
+    romiSim.setInterruptsEnabled(false);
+}
+
+void interrupts() {
+    romiSim.setInterruptsEnabled(true);
+}
+
+// ----- Serial ----- //
+
+void SimSerial::begin(unsigned long baud) {
+    romiSim.serialBegin(baud);
+}
+
+int SimSerial::available() {
+    return romiSim.serialAvailable();
+}
+
+int SimSerial::read() {
+    return romiSim.serialRead();
+}
+
+int SimSerial::peek() {
+    return romiSim.serialPeek();
+}
+
+void SimSerial::flush() {
+    romiSim.serialFlush();
+}
+
+int SimSerial::availableForWrite() {
+    return romiSim.serialFree();
+}
+
+size_t SimSerial::write(uint8_t c) {
+    romiSim.charge(5);
+    romiSim.serialWrite(c);
+    return 1;
+}
+
+size_t SimSerial::write(const uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) write(buf[i]);
+    return len;
+}
+
+size_t SimSerial::print(const char *s) {
+    return write((const uint8_t *)s, strlen(s));
+}
+
+size_t SimSerial::print(char c) {
+    return write((uint8_t)c);
+}
+
+size_t SimSerial::print(int n, int base) {
+    return print((long)n, base);
+}
+
+size_t SimSerial::print(unsigned int n, int base) {
+    return print((unsigned long)n, base);
+}
+
+size_t SimSerial::print(long n, int base) {
+    char buf[40];
+    if (base == 16) snprintf(buf, sizeof(buf), "%lX", n);
+    else snprintf(buf, sizeof(buf), "%ld", n);
+    return print(buf);
+}
+
+size_t SimSerial::print(unsigned long n, int base) {
+    char buf[40];
+    if (base == 16) snprintf(buf, sizeof(buf), "%lX", n);
+    else snprintf(buf, sizeof(buf), "%lu", n);
+    return print(buf);
+}
+
+size_t SimSerial::print(double n, int digits) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return print(buf);
+}
+
+size_t SimSerial::println() {
+    return print("\r\n");
+}
+
+// ----- EEPROM ----- //
+
+uint8_t EEPROMClass::read(int idx) {
+    romiSim.charge(1);
+    return romiSim.eepromRead(idx);
+}
+
+void EEPROMClass::write(int idx, uint8_t val) {
+    romiSim.eepromWrite(idx, val);
+    romiSim.charge(3400);
+}
+
+void EEPROMClass::update(int idx, uint8_t val) {
+    if (read(idx) != val) write(idx, val);
+}
+
+// ----- Romi32U4 ----- //
+
+void Romi32U4Motors::setLeftEffort(int16_t effort) {
+    romiSim.setLeftEffort(effort);
+    romiSim.charge(10);
+}
+
+void Romi32U4Motors::setRightEffort(int16_t effort) {
+    romiSim.setRightEffort(effort);
+    romiSim.charge(10);
+}
+
+void Romi32U4Motors::setEfforts(int16_t leftEffort, int16_t rightEffort) {
+    setLeftEffort(leftEffort);
+    setRightEffort(rightEffort);
+}
+
+int16_t Romi32U4Encoders::getCountsLeft() {
+    romiSim.charge(2);
+    return romiSim.leftCounts(false);
+}
+
+int16_t Romi32U4Encoders::getCountsRight() {
+    romiSim.charge(2);
+    return romiSim.rightCounts(false);
+}
+
+int16_t Romi32U4Encoders::getCountsAndResetLeft() {
+    romiSim.charge(2);
+    return romiSim.leftCounts(true);
+}
+
+int16_t Romi32U4Encoders::getCountsAndResetRight() {
+    romiSim.charge(2);
+    return romiSim.rightCounts(true);
+}
+
+bool Romi32U4ButtonA::isPressed() {
+    romiSim.charge(2);
+    return romiSim.startPressed();
+}
+
+// ----- wpi-32u4-library ----- //
+
+void Servo32U4::SetMinMaxUS(uint16_t min, uint16_t max) {
+    minUS = min;
+    maxUS = max;
+}
+
+void Servo32U4::Write(int microseconds) {
+    romiSim.setGripper(constrain(microseconds, (int)minUS, (int)maxUS));
+    romiSim.charge(3);
+}
+
+int16_t IRDecoder::getKeyCode(bool acknowledge) {
+    romiSim.charge(2);
+    return romiSim.popKey(acknowledge);
+}
+
+// ----- HAL ----- //
+
+void halLifterPWMSetup() {
+    romiSim.setLifterDuty(0);
+}
+
+void halLifterPWM(uint16_t duty) {
+    romiSim.setLifterDuty(duty);
+}
+
+uint8_t halReadLifterEncoder() {
+    return (romiSim.pinRead(2) << 1) | romiSim.pinRead(3);
+}
+
+void halStartTick(void (*fn)()) {
+    romiSim.attachTick(fn, HAL_TICK_MICROS);
+}
+
+// The sampler is modelled by its result: a read returns the plant as it is now
+// rather than up to two conversions ago, and the ISR load is not charged.
+static uint8_t adcPins[HAL_ADC_MAX_CHANNELS];
+static uint8_t adcCount = 0;
+
+void halAdcStart(const uint8_t *pins, uint8_t count) {
+    adcCount = (count > HAL_ADC_MAX_CHANNELS) ? HAL_ADC_MAX_CHANNELS : count;
+    for (uint8_t i = 0; i < adcCount; i++) adcPins[i] = pins[i];
+    romiSim.charge(10);
+}
+
+bool halAdcRead(uint16_t *values) {
+    romiSim.charge(2);
+    for (uint8_t i = 0; i < adcCount; i++) values[i] = romiSim.analog(adcPins[i]);
+    return adcCount > 0;
+}
+
+uint16_t halStackUnused() {
+    return 0;
+}
+
+uint16_t halFreeRam() {
+    return 0;
+}
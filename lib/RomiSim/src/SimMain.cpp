@@ -0,0 +1,123 @@
+/**
+ * Entry point for the native environment. Runs the firmware's setup()/loop()
+ * against the simulated plant until the mission reports completion or the
+ * virtual time limit runs out, then prints where the robot ended up.
+ *
+ *   .pio/build/native/program [--auto2] [--echo] [--limit <seconds>] [--until <text>]
+ *                             [--baud <rate>] [--key <ms>:<code>[:<hold ms>]]... [--capture <file>]
+ *                             [--range-glitch <fraction>] [--line-glitch <fraction>]
+ *                             [--seed <n>] [--vary <scale>] [--serial <ms>:<text>]... [--eeprom <file>]
+ *
+ * --key presses an IR remote key (code from RemoteConstants.h) at a virtual time,
+ * optionally holding it down so it repeats. After the first PlayPause (0x01)
+ * press it also prints stop_latency_us: how long until no motor was being driven,
+ * and restart_after_stop_ms if a motor was driven again afterwards.
+ * --capture writes every byte the firmware transmits to a file, e.g. for
+ * tools/telemetry_decode.py.
+ * --range-glitch sets the fraction of ultrasonic pings that return garbage (default 0.03).
+ * --line-glitch sets the fraction of line sensor readings that read as tape (default 0).
+ * --seed picks the random stream; --vary scatters the start pose and plant around
+ * nominal by that many typical tolerances (see RomiSim::begin()). tools/sim_sweep.py
+ * runs hundreds of seeds and summarises them.
+ * --serial types a line into the serial monitor at a virtual time, e.g.
+ * "--serial 1000:'cal DIST_ROOF 10.6'". --eeprom keeps the EEPROM in a file
+ * between runs.
+ *
+ * Exit status is 0 when the stop marker was seen, 1 on timeout.
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include <Arduino.h>
+#include "RomiSim.h"
+
+void setup();
+void loop();
+
+static const unsigned long LOOP_OVERHEAD_US = 20;   // Arduino main() bookkeeping per pass
+static const uint8_t REMOTE_7 = 0x18;               // Selects autoSequence2() in main.cpp
+
+int main(int argc, char **argv) {
+    RomiSim::Config cfg;
+    float limitSeconds = 180;
+    const char *until = "Autonomous sequence complete.";
+    const char *keys[8];
+    int keyCount = 0;
+    const char *inputs[8];
+    int inputCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--auto2")) cfg.mission = 2;
+        else if (!strcmp(argv[i], "--echo")) cfg.echoSerial = true;
+        else if (!strcmp(argv[i], "--limit") && i + 1 < argc) limitSeconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--until") && i + 1 < argc) until = argv[++i];
+        else if (!strcmp(argv[i], "--baud") && i + 1 < argc) cfg.baud = strtoul(argv[++i], 0, 0);
+        else if (!strcmp(argv[i], "--key") && i + 1 < argc) keys[keyCount++ % 8] = argv[++i];
+        else if (!strcmp(argv[i], "--range-glitch") && i + 1 < argc) cfg.rangeGlitchRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--line-glitch") && i + 1 < argc) cfg.lineGlitchRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) cfg.seed = strtoul(argv[++i], 0, 0);
+        else if (!strcmp(argv[i], "--vary") && i + 1 < argc) cfg.variation = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--serial") && i + 1 < argc) inputs[inputCount++ % 8] = argv[++i];
+        else if (!strcmp(argv[i], "--eeprom") && i + 1 < argc) cfg.eepromFile = argv[++i];
+        else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+            cfg.capture = fopen(argv[++i], "wb");
+            if (!cfg.capture) {
+                perror(argv[i]);
+                return 2;
+            }
+        }
+        else {
+            fprintf(stderr, "usage: %s [--auto2] [--echo] [--limit <seconds>] [--until <text>] [--baud <rate>] [--key <ms>:<code>[:<hold ms>]] [--capture <file>] [--range-glitch <fraction>] [--line-glitch <fraction>] [--seed <n>] [--vary <scale>] [--serial <ms>:<text>] [--eeprom <file>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    romiSim.begin(cfg);
+    romiSim.setStopMarker(until);
+    if (cfg.mission == 2) romiSim.scheduleKey(0, REMOTE_7);
+    for (int i = 0; i < keyCount && i < 8; i++) {
+        char *code;
+        unsigned long ms = strtoul(keys[i], &code, 0);
+        if (*code != ':') continue;
+        char *hold;
+        uint8_t key = (uint8_t)strtoul(code + 1, &hold, 0);
+        romiSim.scheduleKey(ms, key, (*hold == ':') ? strtoul(hold + 1, 0, 0) : 0);
+    }
+    for (int i = 0; i < inputCount && i < 8; i++) {
+        char *text;
+        unsigned long ms = strtoul(inputs[i], &text, 0);
+        if (*text == ':') romiSim.scheduleInput(ms, text + 1);
+    }
+
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    const uint64_t limitUs = (uint64_t)(limitSeconds * 1.0e6);
+
+    setup();
+    while (!romiSim.stopMarkerSeen() && romiSim.nowMicros() < limitUs) {
+        loop();
+        romiSim.charge(LOOP_OVERHEAD_US);
+    }
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double simSeconds = romiSim.nowMicros() / 1.0e6;
+    SimPose p = romiSim.pose();
+
+    printf("mission=%d\n", cfg.mission);
+    printf("seed=%lu\n", (unsigned long)cfg.seed);
+    printf("completed=%d\n", romiSim.stopMarkerSeen() ? 1 : 0);
+    printf("sim_time_s=%.3f\n", simSeconds);
+    printf("wall_time_s=%.3f\n", wall);
+    printf("speedup=%.0f\n", (wall > 0) ? simSeconds / wall : 0.0);
+    printf("pose_x_in=%.2f\n", p.x);
+    printf("pose_y_in=%.2f\n", p.y);
+    printf("pose_heading_deg=%.1f\n", p.heading * 180.0 / PI);
+    printf("lifter_arm_deg=%.2f\n", romiSim.lifterArmDegrees());
+    printf("gripper_us=%d\n", romiSim.gripperMicros());
+    printf("range_in=%.2f\n", romiSim.rangeTruthInches());
+    if (romiSim.stopLatency() >= 0) printf("stop_latency_us=%ld\n", romiSim.stopLatency());
+    if (romiSim.restartAfterStop() >= 0) printf("restart_after_stop_ms=%ld\n", romiSim.restartAfterStop() / 1000);
+
+    romiSim.saveEeprom();
+    if (cfg.capture) fclose(cfg.capture);
+    return romiSim.stopMarkerSeen() ? 0 : 1;
+}
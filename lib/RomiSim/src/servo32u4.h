@@ -0,0 +1,20 @@
+/**
+ * Host-side stand-in for the wpi-32u4-library servo driver. The commanded pulse
+ * width is handed to the simulated gripper.
+ */
+
+#include <Arduino.h>
+
+#pragma once
+
+class Servo32U4 {
+    public:
+        void Init() {}
+        void Attach() {}
+        void Detach() {}
+        void SetMinMaxUS(uint16_t min, uint16_t max);
+        void Write(int microseconds);
+    private:
+        uint16_t minUS = 1000;
+        uint16_t maxUS = 2000;
+};
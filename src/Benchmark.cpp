@@ -0,0 +1,111 @@
+#include <Arduino.h>
+#include "Benchmark.h"
+#include "PIDController.h"
+#include "BlueMotor.h"
+#include "HAL.h"
+
+static volatile float benchInput;   // Volatile so the compiler cannot hoist the work out of the loop
+static volatile float benchSink;
+static volatile long benchEffort;    // The fixed-point result, shifted as the lifter does; same size as benchSink
+static volatile uint8_t benchState;  // Stands in for the oldValue store in the encoder baseline
+
+/**
+ * Run every benchmark and print the per-call cost in CPU cycles over Serial.
+ * Timing comes from micros() averaged over ITERATIONS calls, with the cost of a
+ * loop that does everything except the call subtracted. Only the robot gives
+ * figures: under the native simulator pure computation costs no virtual time,
+ * so every benchmark reports itself as not measured there (see `report()`).
+ * @param lifter The lifter, already set up, whose controller gains are timed
+ */
+void Benchmark::run(BlueMotor &lifter) {
+    Serial.println("----- Benchmark (cycles/call) -----");
+    benchPID(lifter, false);
+    benchPID(lifter, true);
+    benchEncoder();
+    Serial.println("-----------------------------------");
+}
+
+/**
+ * Time one step of a copy of the lifter's own controller, with a moving input:
+ * the same gains and limits as the loop it stands for
+ * @param lifter The lifter whose controller is copied
+ * @param fixed True for the fixed-point step, as `BlueMotor::trackProfile()`
+ *              runs it; false for the float step of the same controller
+ */
+void Benchmark::benchPID(BlueMotor &lifter, bool fixed) {
+    PIDController pid = lifter.bm_PID;
+    pid.setFixedPoint(fixed);
+    pid.setSetpoint(-115.0 * 30.8);
+
+    unsigned long base = baseline();
+    unsigned long start = micros();
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        benchInput = i;
+        if (fixed) benchEffort = pid.calculateEffortFixed(benchInput) >> PIDController::EFFORT_FRAC_BITS;
+        else benchSink = pid.calculateEffort(benchInput);
+    }
+    report(fixed ? "PID fixed-point" : "PID float", micros() - start, base);
+}
+
+/**
+ * Time `BlueMotor::encoderInterrupt()` on its counting path. The lifter is not
+ * moving, so `oldValue` is set to the state before the one on the pins to make
+ * every call a legal single-step transition. Excludes the vector entry/exit and
+ * attachInterrupt() dispatch around the handler.
+ */
+void Benchmark::benchEncoder() {
+    static const uint8_t previousState[4] = {2, 0, 3, 1};
+    BlueMotor motor;
+    uint8_t previous = previousState[halReadLifterEncoder()];
+
+    unsigned long base = encoderBaseline(previous);
+    unsigned long start = micros();
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        benchInput = i;
+        motor.oldValue = previous;
+        motor.encoderInterrupt();
+    }
+    report("Encoder ISR handler", micros() - start, base);
+}
+
+/**
+ * Time the PID loop scaffolding alone, including the `benchSink` store, so it
+ * can be subtracted from the PID results.
+ */
+unsigned long Benchmark::baseline() {
+    unsigned long start = micros();
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        benchInput = i;
+        benchSink = benchInput;
+    }
+    return micros() - start;
+}
+
+/**
+ * Time the encoder loop scaffolding alone. It has no result to store, so this
+ * loop skips `benchSink` and swaps the `oldValue` reset for a store of the same size.
+ * @param previous The encoder state written on each pass
+ */
+unsigned long Benchmark::encoderBaseline(uint8_t previous) {
+    unsigned long start = micros();
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        benchInput = i;
+        benchState = previous;
+    }
+    return micros() - start;
+}
+
+/**
+ * Print one result. The simulator's clock only moves for modelled costs, not for
+ * computation, so there it prints that nothing was measured instead of a figure.
+ */
+void Benchmark::report(const char *name, unsigned long elapsedMicros, unsigned long baselineMicros) {
+    Serial.print(name);
+#ifdef ROMI_SIM
+    Serial.println(": not measured in the simulator");
+#else
+    unsigned long net = (elapsedMicros > baselineMicros) ? elapsedMicros - baselineMicros : 0;
+    Serial.print(": ");
+    Serial.println(net * (F_CPU / 1000000L) / ITERATIONS);
+#endif
+}
@@ -0,0 +1,18 @@
+#include <Arduino.h>
+#include "BlueMotor.h"
+
+#pragma once
+
+class Benchmark {
+    public:
+        void run(BlueMotor &lifter);
+
+    private:
+        void benchPID(BlueMotor &lifter, bool fixed);
+        void benchEncoder();
+        void report(const char *name, unsigned long elapsedMicros, unsigned long baselineMicros);
+        unsigned long baseline();
+        unsigned long encoderBaseline(uint8_t previous);
+
+        const unsigned int ITERATIONS = 1000;
+};
@@ -1,15 +1,29 @@
 #include <Arduino.h>
 #include <Romi32U4.h>
 #include "BlueMotor.h"
+#include "HAL.h"
+#include "Telemetry.h"
+#include "EStop.h"
 
 static BlueMotor *bm_instance; // Create an instance of the BlueMotor class to reference non-static members.
 
+// Quadrature transitions indexed by (old << 2) | new, where each state is (ENCA << 1) | ENCB.
+// The count moves by the negated entry; X marks an illegal jump across two states.
+static const int8_t X = 5;
+static const int8_t encoderTable[16] PROGMEM = {
+    0, -1, 1, X,
+    1, 0, X, -1,
+    -1, X, 0, 1,
+    X, 1, -1, 0
+};
+
 /**
  * Constructor for class BlueMotor  
  */
 BlueMotor::BlueMotor() {
     //bm_PID = PIDController(4.5, 0.02, 0.02);
-    bm_PID = PIDController(5.0, 0.03, 0.02); // PID for aluminum plate 
+    bm_PID = PIDController(5.0, 0.03, 0.0, true); // PID for aluminum plate, fixed-point since it runs every loop (see trackProfile()); D is velocityKd
+    profile.setLimits(maxVelocity, maxAcceleration);
 }
 
 /**
@@ -31,7 +45,8 @@ void BlueMotor::setEffort(int effort) {
         PWM = -effort;
     } else PWM = 0;
 
-    OCR1C = PWM;
+    halLifterPWM(PWM);
+    if (estop.isTripped()) halLifterPWM(0); // Checked after the write, so a trip that lands mid-update still wins
     digitalWrite(AIN1, analog1);
     digitalWrite(AIN2, analog2);
 }
@@ -41,14 +56,13 @@ void BlueMotor::setEffort(int effort) {
  * @param effort Desired effort
  */
 void BlueMotor::setEffortWithoutDB(int effort) {
-    int minPosDBEffort = 120;
-    int minNegDBEffort = -130;
+    effort = constrain(effort, -400, 400);
 
     float posDBEffortRange = 400 - minPosDBEffort;
     float negDBEffortRange = 400 + minNegDBEffort;
 
     float posDBEffort = effort * (posDBEffortRange/400) + minPosDBEffort;
-    float negDBEffort = effort * (negDBEffortRange/400) - minNegDBEffort;
+    float negDBEffort = effort * (negDBEffortRange/400) + minNegDBEffort;
 
     int analog1, analog2 = 0;
     int PWM = 0;
@@ -64,68 +78,281 @@ void BlueMotor::setEffortWithoutDB(int effort) {
 
     applEff = PWM; // Dirty global variable because I'm lazy.
 
-    OCR1C = PWM;
+    halLifterPWM(PWM);
+    if (estop.isTripped()) halLifterPWM(0); // Checked after the write, so a trip that lands mid-update still wins
     digitalWrite(AIN1, analog1);
     digitalWrite(AIN2, analog2);
 }
 
 /**
- * Move to a specified position, and then stop. Blocking Function.
+ * Move to a specified position along the motion profile, and then stop. Blocking
+ * Function; runs the controller itself, so only use it where the scheduler's
+ * lifter task is not also running it.
  * @param longPosition Desired position, in degrees
  */
 void BlueMotor::moveTo(float longPosition) {
-    float PIDOut;
-    bm_PID.setSetpoint(longPosition);
-
-    while(!bm_PID.onTarget(getPosition())) {
-        PIDOut = bm_PID.calculateEffort(getPosition());
-        setEffortWithoutDB(-PIDOut);
-
-        Serial.print("Current Pos.: ");
-        Serial.print(getPosition());
-        Serial.print("  || Setpoint: ");
-        Serial.print(pullSetpoint());
-        Serial.print("  || PID Output: ");
-        Serial.print(PIDOut);
-        Serial.print("  || Applied Effort: ");
-        Serial.print(applEff);
-        Serial.print("  || PID Kp: ");
-        Serial.print(pullGain(1));
-        Serial.print("  || PID Ki: ");
-        Serial.print(pullGain(2));
-        Serial.print("  || PID Kd: ");
-        Serial.println(pullGain(3));
-
+    startMoveTo(longPosition);
+    SensorFrame frame;
+    while(controllerActive) {
+        sample(frame);
+        loopController(frame);
         delay(10); // 100Hz controller.
     }
-    setEffort(0);
 }
 
 /**
- * A non-blocking version of the `moveTo()` method that sets the setpoint
- * and begins turning the motors.
+ * A non-blocking version of the `moveTo()` method. Plans a velocity- and
+ * acceleration-limited profile from the current position and hands the lifter
+ * to `loopController()`. Calling it again with the move's target while the
+ * move is running does nothing.
  * @param position Desired position, in degrees
  */
 void BlueMotor::startMoveTo(float position) {
-    bm_PID.setSetpoint(position);  
-    setEffortWithoutDB( -bm_PID.calculateEffort(getPosition()) );
-    delay(10); // Run at 100Hz
+    if (controllerActive && position == profile.getTarget()) return;
+
+    float here = getPosition();
+    profile.start(here, position);
+    bm_PID.reset();
+    bm_PID.setSetpoint(here);
+    controllerActive = true;
 }
 
 /**
- * Accompanying function to `startMoveTo()` that runs a non-blocking PID algorithm
+ * Pick up after an E-stop pause. A profiled move starts again from where the
+ * lifter is now, since the profile's clock ran on through the pause. A gravity
+ * scan moves back to the point it was on and measures it again. An auto-tune
+ * is aborted, as the pause broke its limit cycle.
  */
-void BlueMotor::loopController() {
-    if (!bm_PID.onTarget(getPosition())) {
-        Serial.print("Current Pos.: ");
-        Serial.print(getPosition());
-        Serial.print("  || Setpoint: ");
-        Serial.println(pullSetpoint());
-        setEffortWithoutDB( -bm_PID.calculateEffort(getPosition()) );
-        delay(10); // Run at 100Hz
+void BlueMotor::resume() {
+    if (autoTuning) {
+        autoTuning = false;
+        Serial.println("Auto-tune aborted: E-stop");
+    }
+    if (scanning) pointStarted = false;
+    if (!controllerActive) return;
+
+    float here = getPosition();
+    profile.start(here, profile.getTarget());
+    bm_PID.reset();
+    bm_PID.setSetpoint(here);
+}
+
+/**
+ * Read the encoder once, refresh the velocity estimate from it, and fill in the
+ * lifter part of the tick's sensor frame. Call once per tick, before the
+ * controller.
+ */
+void BlueMotor::sample(SensorFrame &frame) {
+    updateVelocity();
+    frame.lifterPosition = position;
+    frame.lifterVelocity = velocity;
+}
+
+/**
+ * Accompanying function to `startMoveTo()` that advances the profile and runs one
+ * step of the PID algorithm against it. Call at a fixed rate (the scheduler runs
+ * it at 100Hz) with this tick's frame from `sample()`. The controller lets go once
+ * the profile has finished and the lifter is on target and has stopped, until
+ * `startMoveTo()` is called again.
+ */
+void BlueMotor::loopController(const SensorFrame &frame) {
+    if (!controllerActive) return;
+
+    bm_PID.setSetpoint(profile.getSetpoint());
+    if (!profile.isComplete() || !bm_PID.onTarget(frame.lifterPosition) || fabs(frame.lifterVelocity) > settledVelocity) {
+        trackProfile(frame);
     } else {
         setEffort(0);
+        controllerActive = false;
+    }
+}
+
+/**
+ * Start a relay-feedback experiment about the current position. Runs from
+ * `loopAutoTune()` instead of `loopController()`. The efforts that just start
+ * the lifter moving up and down are measured first, then the lifter oscillates a
+ * few motor degrees either side for a few seconds, then the new gains are
+ * applied and printed. Not while a gravity scan runs.
+ */
+void BlueMotor::startAutoTune() {
+    if (scanning) {
+        Serial.println("Auto-tune not started: gravity scan running");
+        return;
+    }
+    controllerActive = false;
+    tuneCentre = getPosition();
+    startBreakaway(tuneCentre);
+    relayCentred = false;
+    tuneStartMillis = millis();
+    autoTuning = true;
+    tuned = false;
+    Serial.println("Auto-tune started");
+}
+
+/**
+ * Accompanying function to `startAutoTune()`: one step of the relay experiment.
+ * The relay swings a fixed effort either side of the effort that cancels gravity
+ * where the lifter is, measured by `measureBreakaway()` (the feedforward table
+ * may not be measured yet), so the swing is the same both ways. It flips as the
+ * lifter crosses the centre; the period and amplitude of the resulting limit
+ * cycle give the ultimate gain and period (Astrom-Hagglund). Call at the
+ * controller rate.
+ */
+void BlueMotor::loopAutoTune(const SensorFrame &frame) {
+    if (!autoTuning) return;
+
+    float position = frame.lifterPosition;
+    if (abs(position - tuneCentre) > tuneMaxExcursion || millis() - tuneStartMillis > tuneTimeout) {
+        setEffort(0);
+        autoTuning = false;
+        Serial.println("Auto-tune aborted");
+        return;
+    }
+
+    if (!relayCentred) {
+        if (!measureBreakaway(frame)) return;
+        relayCentred = true;
+        relayCentre = breakGravity;
+        tuneCentre = position;
+        tuneHigh = tuneLow = position;
+        tuneCycle = 0;
+        tunePeriodSum = 0.0;
+        tuneAmplitudeSum = 0.0;
+        relayPositive = false;
+        tuneCycleMicros = micros();
+        Serial.print("  || Relay centre effort: ");
+        Serial.println(relayCentre);
+    }
+
+    if (position > tuneHigh) tuneHigh = position;
+    if (position < tuneLow) tuneLow = position;
+
+    if (relayPositive && position > tuneCentre + relayHysteresis) {
+        relayPositive = false;
+    } else if (!relayPositive && position < tuneCentre - relayHysteresis) {
+        // One full cycle ends each time the relay turns positive
+        relayPositive = true;
+        unsigned long now = micros();
+        if (tuneCycle >= TUNE_SKIP_CYCLES) {
+            tunePeriodSum += (now - tuneCycleMicros) * 1.0e-6;
+            tuneAmplitudeSum += (tuneHigh - tuneLow) / 2.0;
+        }
+        tuneCycleMicros = now;
+        tuneHigh = tuneLow = position;
+        if (++tuneCycle >= TUNE_SKIP_CYCLES + TUNE_CYCLES) {
+            finishAutoTune();
+            return;
+        }
+    }
+
+    int relay = relayPositive ? relayEffort : -relayEffort;
+    setEffortWithoutDB(relayCentre + relay);
+}
+
+bool BlueMotor::isAutoTuning() {
+    return autoTuning;
+}
+
+/**
+ * @return True if the last auto-tune ran to the end and applied new gains; false
+ *         while one runs or after one aborts
+ */
+bool BlueMotor::isTuned() {
+    return tuned;
+}
+
+/**
+ * Measure the gravity feedforward table. The lifter moves up to each of the
+ * table's points in turn and finds the efforts that just start it moving up and
+ * down there; see `measureBreakaway()`. Runs from `loopGravityScan()` instead of
+ * `loopController()`, and cannot be started while an auto-tune runs. Points
+ * above `top` are given the last value measured.
+ * @param top Highest position the lifter may go to, in degrees (negative is up)
+ */
+void BlueMotor::startGravityScan(float top) {
+    if (autoTuning || scanning) {
+        Serial.println("Gravity scan not started: lifter busy");
+        return;
+    }
+    scanPoints = 0;
+    while (scanPoints < GRAVITY_POINTS && ((long)scanPoints << GRAVITY_SHIFT) <= -top) scanPoints++;
+    if (scanPoints == 0) {
+        Serial.println("Gravity scan not started: no point below the top");
+        return;
+    }
+    scanPoint = 0;
+    pointStarted = false;
+    scanning = true;
+    Serial.println("Gravity scan started");
+}
+
+/**
+ * Accompanying function to `startGravityScan()`: one controller step of the
+ * scan. Call at the controller rate.
+ */
+void BlueMotor::loopGravityScan(const SensorFrame &frame) {
+    if (!scanning) return;
+
+    if (!pointStarted) {
+        float height = (long)scanPoint << GRAVITY_SHIFT;
+        startMoveTo(-(height < scanClearance ? scanClearance : height));
+        pointStarted = true;
     }
+    if (controllerActive) {
+        loopController(frame);
+        if (!controllerActive) startBreakaway(frame.lifterPosition);
+        return;
+    }
+    if (!measureBreakaway(frame)) return;
+
+    gravityTable[scanPoint] = breakGravity;
+    Serial.print("  || Gravity point ");
+    Serial.print(scanPoint);
+    Serial.print(": ");
+    Serial.println(breakGravity);
+
+    pointStarted = false;
+    if (++scanPoint < scanPoints) return;
+    for (uint8_t i = scanPoints; i < GRAVITY_POINTS; i++) gravityTable[i] = breakGravity;
+    scanning = false;
+    Serial.println("Gravity scan done");
+}
+
+/**
+ * @return True until the gravity scan has measured its last point
+ */
+bool BlueMotor::isScanning() {
+    return scanning;
+}
+
+/**
+ * Set one entry of the gravity feedforward table. All zero (no feedforward)
+ * until the table has been measured; see `startGravityScan()`.
+ * @param point Table index; point i is i << GRAVITY_SHIFT motor degrees above the zero
+ * @param effort Effort that cancels gravity there, before deadband compensation
+ */
+void BlueMotor::setGravity(uint8_t point, int effort) {
+    if (point < GRAVITY_POINTS) gravityTable[point] = effort;
+}
+
+/**
+ * @param point Table index, as for `setGravity()`
+ * @return Gravity effort stored for that point
+ */
+int BlueMotor::pullGravity(uint8_t point) {
+    return (point < GRAVITY_POINTS) ? gravityTable[point] : 0;
+}
+
+/**
+ * Replace the lifter feedback gains. A move in progress carries on from where it
+ * is, integral included.
+ * @param kp Effort per motor degree of position error
+ * @param ki Effort per motor degree of error, per 10ms controller step
+ * @param kd Effort per motor degree/s of velocity error
+ */
+void BlueMotor::setGains(float kp, float ki, float kd) {
+    bm_PID.setGains(kp, ki, 0.0);
+    velocityKd = kd;
 }
 
 /**
@@ -140,6 +367,14 @@ float BlueMotor::getPosition() {
     return pos;
 }
 
+/**
+ * Get the velocity of the motor, as of the last controller step
+ * @return Velocity in degrees per second, positive down like the position
+ */
+float BlueMotor::getVelocity() {
+    return velocity;
+}
+
 /**
  * Reset the count on the encoder
  */        
@@ -156,6 +391,7 @@ void BlueMotor::setup() {
     bm_instance = this;
 
     bm_PID.setTolerance(tolerance);
+    bm_PID.setOutputLimit(400); // Full effort; the integral cannot wind up past it while the lifter is stalled
 
     //motors.setEfforts(0, 0);
     pinMode(PWMOutPin, OUTPUT);
@@ -165,6 +401,7 @@ void BlueMotor::setup() {
     pinMode(ENCB, INPUT);
     pwmSetup();
 
+    oldValue = halReadLifterEncoder();
     attachInterrupt(digitalPinToInterrupt(ENCA), isr, CHANGE);
     attachInterrupt(digitalPinToInterrupt(ENCB), isr, CHANGE);
     reset();
@@ -184,15 +421,41 @@ float BlueMotor::pullSetpoint() {
  * @return Gain value
  */
 float BlueMotor::pullGain(int index) {
-    return bm_PID.getGainValue(index);
+    return (index == 3) ? velocityKd : bm_PID.getGainValue(index); // D acts on measured velocity, not in bm_PID
 } 
 
 /**
  * Pull the PID onTarget status from the local PIDController instance
- * @return True if the lifter is on target. 
+ * @return True if the motion profile has finished and the lifter is on target.
  */
-bool BlueMotor::pullOnTarget() {
-    return bm_PID.onTarget(getPosition());
+bool BlueMotor::pullOnTarget(const SensorFrame &frame) {
+    return profile.isComplete() && bm_PID.onTarget(frame.lifterPosition);
+}
+
+/**
+ * Number of illegal encoder transitions (both channels changed between interrupts).
+ * Each one means at least one edge was missed and the count may be off by two.
+ * @return Illegal transitions since boot
+ */
+unsigned int BlueMotor::getErrorCount() {
+    unsigned int n;
+    noInterrupts();
+    n = errorCount;
+    interrupts();
+    return n;
+}
+
+/**
+ * Number of encoder interrupts that found neither channel changed, e.g. from
+ * contact bounce or an edge already consumed by the previous interrupt.
+ * @return Spurious interrupts since boot
+ */
+unsigned int BlueMotor::getSpuriousCount() {
+    unsigned int n;
+    noInterrupts();
+    n = spuriousCount;
+    interrupts();
+    return n;
 }
 
 // ----- PRIVATE CLASS METHODS BELOW ----- //
@@ -211,10 +474,7 @@ void BlueMotor::setEffort(int effort, bool clockwise) {
  * Setup PWM interrupt registers
  */
 void BlueMotor::pwmSetup() {
-    TCCR1A = 0xA8; 
-    TCCR1B = 0x11; 
-    ICR1 = 400;
-    OCR1C = 0;
+    halLifterPWMSetup();
 }
 
 /**
@@ -225,17 +485,207 @@ void BlueMotor::isr() {
 }
 
 /**
- * Event handler for encoder ISR.
+ * Event handler for encoder ISR. Both channels come from one port read and the
+ * transition is looked up in flash. Interrupts are already off inside an ISR,
+ * so `count` is updated without a critical section.
  */
 void BlueMotor::encoderInterrupt() {
-    newValue = (digitalRead(ENCA) << 1) | digitalRead(ENCB);
-    char value = encoderArray[oldValue] [newValue];
+    uint8_t newValue = halReadLifterEncoder();
+    int8_t value = pgm_read_byte(&encoderTable[(oldValue << 2) | newValue]);
     if (value == X) {
-        errorCount++;
+        errorCount++;   // Read by the main loop; a burst of faults must not flood the event ring
+    } else if (value == 0) {
+        spuriousCount++;
     } else {
-        noInterrupts();
         count -= value;
-        interrupts();
+
+        unsigned long now = micros();
+        if (value != edgeDirection) {
+            edgeDirection = value;
+            edgeRun = 1;
+        } else if (edgeRun <= EDGE_WINDOW) {
+            edgeRun++;
+        }
+        edgeSpan = now - edgeTimes[edgeIndex];
+        edgeTimes[edgeIndex] = now;
+        edgeIndex = (edgeIndex + 1) & (EDGE_WINDOW - 1);
+        lastEdgeMicros = now;
     }
     oldValue = newValue;
-}
\ No newline at end of file
+}
+
+/**
+ * Refresh the position and velocity estimates from one snapshot. Between a few edges per update the count
+ * difference is mostly quantization, so it is blended toward the edge period
+ * (one quadrature cycle, which cancels the phase error between channels). While
+ * the lifter slows, the time since the last edge bounds the period from below.
+ */
+void BlueMotor::updateVelocity() {
+    noInterrupts();
+    long c = count;
+    unsigned long span = edgeSpan;
+    unsigned long lastEdge = lastEdgeMicros;
+    int8_t direction = edgeDirection;
+    uint8_t run = edgeRun;
+    interrupts();
+    position = (float)c / (float)encoderCountPerRev * 360.0;
+
+    unsigned long now = micros();
+    long edges = c - velocityCount;
+    unsigned long dt = now - velocityMicros;
+    velocityCount = c;
+    velocityMicros = now;
+    if (dt == 0) return;
+
+    const float degreesPerCount = 360.0 / encoderCountPerRev;
+    float countVelocity = edges * degreesPerCount * 1.0e6 / dt;
+
+    float periodVelocity = 0.0;
+    unsigned long sinceEdge = now - lastEdge;
+    if (run > EDGE_WINDOW && sinceEdge < STOPPED_MICROS) {
+        float period = (float)span / EDGE_WINDOW;
+        if (sinceEdge > period) period = sinceEdge;
+        periodVelocity = -direction * degreesPerCount * 1.0e6 / period;
+    }
+
+    long edgeCount = labs(edges);
+    float weight = (edgeCount < BLEND_EDGES) ? edgeCount / (float)BLEND_EDGES : 1.0;
+    velocity = weight * countVelocity + (1.0 - weight) * periodVelocity;
+}
+
+/**
+ * One step of the position loop along the profile; unlike `loopController()` it
+ * never lets go. The feedforwards carry gravity and the cruise effort, leaving PID
+ * only the tracking error, and the damping comes from the measured velocity
+ * instead of differenced counts. Set the PID setpoint from the profile first.
+ * @return Effort commanded, before deadband compensation
+ */
+int BlueMotor::trackProfile(const SensorFrame &frame) {
+    float position = frame.lifterPosition;
+    long PIDOutQ = bm_PID.calculateEffortFixed(position);
+    int PIDOut = (PIDOutQ + (1L << (PIDController::EFFORT_FRAC_BITS - 1))) >> PIDController::EFFORT_FRAC_BITS;
+    float damping = velocityKd * (frame.lifterVelocity - profile.getVelocity());
+    int effort = gravityFeedforward(position) + velocityFF * profile.getVelocity() - PIDOut - damping;
+    setEffortWithoutDB(effort);
+    sendTelemetry(position, PIDOut);
+    return effort;
+}
+
+/**
+ * Start a break-away measurement where the lifter is now, at rest
+ */
+void BlueMotor::startBreakaway(float position) {
+    setEffort(0);
+    breakPhase = BREAK_UP_SETTLE;
+    breakTicks = 0;
+    breakStart = position;
+}
+
+/**
+ * One step of a break-away measurement. From rest, the raw PWM ramps up one
+ * count per step until the lifter has moved `breakawayDegrees` up, then, after
+ * it has come to rest again, the same down. Friction resists both ways and
+ * gravity helps one of them, so half the sum of the two is what gravity alone
+ * needs, in PWM. Scaled by the slope of the deadband compensation it becomes
+ * an effort for `setEffortWithoutDB()`, left in `breakGravity`.
+ * @return True once `breakGravity` holds the result
+ */
+bool BlueMotor::measureBreakaway(const SensorFrame &frame) {
+    float position = frame.lifterPosition;
+    switch (breakPhase) {
+        case BREAK_UP_SETTLE:
+        case BREAK_DOWN_SETTLE:
+        if (++breakTicks < BREAK_SETTLE_TICKS) return false;
+        breakStart = position;
+        breakEffort = 0;
+        breakPhase++;
+        return false;
+
+        case BREAK_UP:
+        if (position > breakStart - breakawayDegrees && breakEffort > -400) {
+            setEffort(--breakEffort);
+            return false;
+        }
+        breakUpEffort = breakEffort;
+        setEffort(0);
+        breakTicks = 0;
+        breakPhase = BREAK_DOWN_SETTLE;
+        return false;
+
+        default:
+        if (position < breakStart + breakawayDegrees && breakEffort < 400) {
+            setEffort(++breakEffort);
+            return false;
+        }
+        setEffort(0);
+        int pwm = (breakUpEffort + breakEffort) / 2;
+        breakGravity = (pwm < 0) ? (long)pwm * 400 / (400 + minNegDBEffort) : (long)pwm * 400 / (400 - minPosDBEffort);
+        return true;
+    }
+}
+
+/**
+ * Turn the measured limit cycle into gains with the Ziegler-Nichols
+ * "no overshoot" rule, which settles fast without the ringing of classic Z-N.
+ */
+void BlueMotor::finishAutoTune() {
+    setEffort(0);
+    autoTuning = false;
+
+    float period = tunePeriodSum / TUNE_CYCLES;
+    float amplitude = tuneAmplitudeSum / TUNE_CYCLES;
+    // Describing function of a relay with hysteresis
+    float span = amplitude * amplitude - relayHysteresis * relayHysteresis;
+    span = (span > 1.0) ? sqrt(span) : 1.0;
+    float ultimateGain = 4.0 * relayEffort / (PI * span);
+
+    float kp = 0.2 * ultimateGain;
+    float ki = kp * controllerPeriod / (period / 2.0);
+    float kd = kp * period / 3.0;
+    setGains(kp, ki, kd);
+    tuned = true;
+
+    Serial.print("  || Ku: ");
+    Serial.print(ultimateGain, 3);
+    Serial.print(" Tu: ");
+    Serial.print(period, 3);
+    Serial.print(" amplitude: ");
+    Serial.println(amplitude);
+    Serial.print("Auto-tune gains Kp: ");
+    Serial.print(kp, 3);
+    Serial.print(" Ki: ");
+    Serial.print(ki, 4);
+    Serial.print(" Kd: ");
+    Serial.println(kd, 4);
+}
+
+/**
+ * Look up the effort that holds the lifter against gravity, interpolating
+ * linearly between table entries in integer math. The table comes from
+ * calibration (`setGravity()`), and is all zero until it has been measured.
+ * Holding torque peaks with the arm near horizontal and reverses once it passes
+ * over the top.
+ * @param position Lifter position, in degrees
+ * @return Effort to add before deadband compensation
+ */
+int BlueMotor::gravityFeedforward(float position) {
+    const long top = (long)(GRAVITY_POINTS - 1) << GRAVITY_SHIFT;
+    long height = constrain(-(long)position, 0L, top); // Motor degrees above the zero
+
+    uint8_t i = height >> GRAVITY_SHIFT;
+    int16_t low = gravityTable[i];
+    if (i == GRAVITY_POINTS - 1) return low;
+
+    int16_t high = gravityTable[i + 1];
+    long fraction = height & ((1L << GRAVITY_SHIFT) - 1);
+    return low + (int)(((high - low) * fraction) >> GRAVITY_SHIFT);
+}
+
+/**
+ * Queue one lifter controller sample on the telemetry stream
+ * @param PIDOut Raw output of `bm_PID` for this step
+ */
+void BlueMotor::sendTelemetry(float position, float PIDOut) {
+    telemetry.send(Telemetry::LIFTER, position, pullSetpoint(), PIDOut, applEff, 0,
+                   pullGain(1), pullGain(2), pullGain(3));
+}
@@ -1,6 +1,8 @@
 #include <Romi32U4.h>
 #include <Arduino.h>
 #include "PIDController.h"
+#include "MotionProfile.h"
+#include "SensorFrame.h"
 
 #pragma once
 
@@ -11,25 +13,75 @@ class BlueMotor {
         void setEffortWithoutDB(int effort);
         void moveTo(float longPosition);
         void startMoveTo(float position);
-        void loopController();
+        void resume();
+        void sample(SensorFrame &frame);
+        void loopController(const SensorFrame &frame);
         float getPosition();
+        float getVelocity();
         void reset();
         void setup();
         float pullSetpoint();
         float pullGain(int index);
-        bool pullOnTarget();
+        bool pullOnTarget(const SensorFrame &frame);
+        void startAutoTune();
+        void loopAutoTune(const SensorFrame &frame);
+        bool isAutoTuning();
+        bool isTuned();
+        void startGravityScan(float top);
+        void loopGravityScan(const SensorFrame &frame);
+        bool isScanning();
+        void setGravity(uint8_t point, int effort);
+        int pullGravity(uint8_t point);
+        void setGains(float kp, float ki, float kd);
+        unsigned int getErrorCount();
+        unsigned int getSpuriousCount();
 
         int applEff = 0;
+
+        // Gravity feedforward table: one holding effort every 2^GRAVITY_SHIFT motor degrees of lift
+        static const uint8_t GRAVITY_POINTS = 10;
+        static const uint8_t GRAVITY_SHIFT = 9;
         
     private:
+        friend class Benchmark;
+
         PIDController bm_PID;
+        MotionProfile profile;
         void setEffort(int effort, bool clockwise);
         void pwmSetup();
         static void isr();
         void encoderInterrupt();
+        void updateVelocity();
+        int trackProfile(const SensorFrame &frame);
+        void startBreakaway(float position);
+        bool measureBreakaway(const SensorFrame &frame);
+        int gravityFeedforward(float position);
+        void sendTelemetry(float position, float PIDOut);
+        void finishAutoTune();
 
         const int encoderCountPerRev = 540;
         const float tolerance = 5.0;
+        const float settledVelocity = 20.0;     // Motor degrees/s; on target and slower than this lets the controller go
+        const float maxVelocity = 600.0;        // Profile cruise speed, motor degrees/s; a little under full-effort speed lifting
+        const float maxAcceleration = 2000.0;   // Profile acceleration, motor degrees/s^2
+        const float velocityFF = 0.65;          // Effort per motor degree/s of profile velocity
+        float velocityKd = 0.1;                 // Effort per motor degree/s of velocity tracking error
+
+        // Relay auto-tune
+        const float controllerPeriod = PIDController::SAMPLE_MICROS * 1.0e-6;  // Seconds per step of the gains' Ki
+        const float relayEffort = 60.0;         // Relay swing either side of the effort that cancels gravity
+        const float relayHysteresis = 2.0;      // Motor degrees either side of the centre before switching
+        const float tuneMaxExcursion = 300.0;   // Motor degrees from the centre before giving up
+        const unsigned long tuneTimeout = 20000; // Milliseconds
+        static const uint8_t TUNE_SKIP_CYCLES = 2;      // Settling cycles discarded before measuring
+        static const uint8_t TUNE_CYCLES = 4;           // Cycles averaged
+
+        // Break-away measurement (gravity scan, auto-tune relay centre)
+        static const uint8_t BREAK_SETTLE_TICKS = 30;   // Controller steps at rest before each ramp
+        const float breakawayDegrees = 2.0;     // Motor degrees of travel that count as moving
+        const float scanClearance = 60.0;       // Motor degrees above the zero for point 0, clear of the stop at the bottom
+        static const int minPosDBEffort = 120;  // Deadband compensation: PWM at the smallest effort down
+        static const int minNegDBEffort = -130; // ...and up
         
         const int PWMOutPin = 11;
         const int AIN2 = 4;
@@ -37,16 +89,52 @@ class BlueMotor {
         const int ENCA = 2;
         const int ENCB = 3;   
 
-        int newValue = 0;
-        int oldValue = 0;
-        long count = 0;
-        long errorCount = 0;
-        
-        const char X = 5;
-        char encoderArray[4][4] = {
-            {0, -1, 1, X},
-            {1, 0, X, -1},
-            {-1, X, 0, 1},
-            {X, 1, -1, 0}
-        };
+        // Velocity estimate: 1/T from edge timestamps at low speed, count difference at high speed
+        static const uint8_t EDGE_WINDOW = 4;           // Edges per period measurement (one quadrature cycle); power of two
+        static const uint8_t BLEND_EDGES = 8;           // Edges per update at which the estimate is all count difference
+        static const unsigned long STOPPED_MICROS = 100000; // No edge for this long reads as stopped
+
+        uint8_t oldValue = 0;
+        volatile long count = 0;
+        volatile unsigned int errorCount = 0;      // Illegal transitions: both channels changed, so an edge was missed
+        volatile unsigned int spuriousCount = 0;   // Interrupts that found no change on either channel
+        volatile unsigned long edgeTimes[EDGE_WINDOW] = {};  // micros() of the last EDGE_WINDOW counted edges
+        volatile unsigned long edgeSpan = 0;            // Time across the last EDGE_WINDOW edges
+        volatile unsigned long lastEdgeMicros = 0;
+        volatile int8_t edgeDirection = 0;              // Table value of the last edge; the count moves opposite
+        volatile uint8_t edgeRun = 0;                   // Consecutive edges in one direction, up to EDGE_WINDOW + 1
+        uint8_t edgeIndex = 0;
+        long velocityCount = 0;                         // Count and time at the previous updateVelocity()
+        unsigned long velocityMicros = 0;
+        float velocity = 0.0;                           // Motor degrees per second
+        float position = 0.0;                           // Motor degrees, from the same snapshot as `velocity`
+        bool controllerActive = false;
+
+        bool autoTuning = false;
+        bool tuned = false;                 // The last auto-tune finished and applied its gains
+        bool relayPositive = false;
+        bool relayCentred = false;          // The break-away measurement before the relay has finished
+        int relayCentre = 0;                // Effort that cancels gravity at the tune position
+        uint8_t tuneCycle = 0;              // Cycles completed, including the discarded ones
+        float tuneCentre = 0.0;
+        float tuneHigh = 0.0;               // Extremes of the cycle in progress
+        float tuneLow = 0.0;
+        float tunePeriodSum = 0.0;          // Seconds
+        float tuneAmplitudeSum = 0.0;       // Motor degrees, half peak-to-peak
+        unsigned long tuneStartMillis = 0;
+        unsigned long tuneCycleMicros = 0;
+
+        int16_t gravityTable[GRAVITY_POINTS] = {};  // Effort that cancels gravity at each point; negative is up
+        bool scanning = false;
+        bool pointStarted = false;          // The move to `scanPoint` has been planned; the measurement follows it
+        uint8_t scanPoint = 0;
+        uint8_t scanPoints = 0;             // Points at or below the top of the scan
+
+        enum BreakPhase : uint8_t { BREAK_UP_SETTLE, BREAK_UP, BREAK_DOWN_SETTLE, BREAK_DOWN };
+        uint8_t breakPhase = BREAK_UP_SETTLE;
+        uint8_t breakTicks = 0;
+        int breakEffort = 0;                // PWM of the ramp in progress; negative is up
+        int breakUpEffort = 0;              // PWM that started the lifter moving up
+        float breakStart = 0.0;             // Position the ramp in progress started from
+        int breakGravity = 0;               // Result: effort that cancels gravity, before deadband compensation
 };
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "Calibration.h"
+
+Calibration calibration;
+
+// Indexed by Calibration::Param; fixed width so the table can live in flash.
+static const char paramNames[Calibration::COUNT][18] PROGMEM = {
+    "", "GRIPPER_OPEN", "GRIPPER_CLOSED", "GEAR_RATIO_LIFTER", "LIFTER_PLATFORM",
+    "LIFTER_25ROOF", "LIFTER_45ROOF", "DIST_PLATFORM", "DIST_ROOF",
+    "LIFTER_KP", "LIFTER_KI", "LIFTER_KD", "LINE_LEFT_MIN", "LINE_LEFT_MAX", "LINE_RIGHT_MIN", "LINE_RIGHT_MAX",
+    "LIFTER_GRAVITY_0", "LIFTER_GRAVITY_1", "LIFTER_GRAVITY_2", "LIFTER_GRAVITY_3", "LIFTER_GRAVITY_4",
+    "LIFTER_GRAVITY_5", "LIFTER_GRAVITY_6", "LIFTER_GRAVITY_7", "LIFTER_GRAVITY_8", "LIFTER_GRAVITY_9"
+};
+
+/**
+ * CRC-16/CCITT-FALSE, one byte at a time
+ */
+static uint16_t crcUpdate(uint16_t crc, uint8_t data) {
+    crc ^= (uint16_t)data << 8;
+    for (uint8_t i = 0; i < 8; i++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
+
+/**
+ * Load the saved block, or keep the defaults if there is none or it fails its
+ * CRC. Prints which one it used.
+ * @param defaults COUNT values in PROGMEM, indexed by Param
+ */
+void Calibration::load(const float *defaults) {
+    this->defaults = defaults;
+    for (uint8_t i = 0; i < COUNT; i++) values[i] = pgm_read_float(&defaults[i]);
+
+    Header header;
+    EEPROM.get(EEPROM_ADDRESS, header);
+    int end = EEPROM_ADDRESS + sizeof(Header) + header.count * sizeof(float);
+    if (header.magic != MAGIC || header.version != CALIBRATION_VERSION
+        || end + (int)sizeof(uint16_t) > (int)EEPROM.length()) {
+        Serial.println("Calibration: no saved block, using defaults");
+        return;
+    }
+
+    uint16_t crc = 0xFFFF;
+    for (int i = EEPROM_ADDRESS; i < end; i++) crc = crcUpdate(crc, EEPROM.read(i));
+    uint16_t stored;
+    EEPROM.get(end, stored);
+    if (crc != stored) {
+        Serial.println("Calibration: bad CRC, using defaults");
+        return;
+    }
+
+    // Parameter 0 is never stored. Extra values from newer firmware are ignored.
+    uint8_t count = (header.count < COUNT - 1) ? header.count : COUNT - 1;
+    for (uint8_t i = 0; i < count; i++) EEPROM.get(EEPROM_ADDRESS + sizeof(Header) + i * sizeof(float), values[i + 1]);
+    Serial.print("Calibration: loaded ");
+    Serial.print(count);
+    Serial.println(" values");
+}
+
+/**
+ * Write the current values to EEPROM. Only bytes that changed are rewritten, so
+ * saving an unchanged block costs no EEPROM wear.
+ * @return True if the block reads back intact
+ */
+bool Calibration::save() {
+    Header header = {MAGIC, CALIBRATION_VERSION, COUNT - 1};
+    EEPROM.put(EEPROM_ADDRESS, header);
+    for (uint8_t i = 1; i < COUNT; i++) EEPROM.put(EEPROM_ADDRESS + sizeof(Header) + (i - 1) * sizeof(float), values[i]);
+
+    int end = EEPROM_ADDRESS + sizeof(Header) + (COUNT - 1) * sizeof(float);
+    uint16_t crc = 0xFFFF;
+    for (int i = EEPROM_ADDRESS; i < end; i++) crc = crcUpdate(crc, EEPROM.read(i));
+    EEPROM.put(end, crc);
+
+    uint16_t check;
+    EEPROM.get(end, check);
+    return check == crc;
+}
+
+/**
+ * Put every value back to its compiled default (in RAM only)
+ */
+void Calibration::resetToDefaults() {
+    for (uint8_t i = 0; i < COUNT; i++) values[i] = pgm_read_float(&defaults[i]);
+    if (listener) listener(NONE);
+}
+
+/**
+ * Change a value in RAM. Takes effect immediately; `save()` keeps it.
+ */
+void Calibration::set(uint8_t param, float value) {
+    if (param == NONE || param >= COUNT) return;
+    values[param] = value;
+    if (listener) listener(param);
+}
+
+/**
+ * Change several values in RAM at once. The listener only hears about them once
+ * they are all stored, so a copy made from more than one value (e.g. the three
+ * lifter gains) never mixes old and new ones.
+ * @param params Params to change
+ * @param newValues Their new values, in the same order
+ * @param count Entries in each array
+ */
+void Calibration::set(const uint8_t *params, const float *newValues, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (params[i] != NONE && params[i] < COUNT) values[params[i]] = newValues[i];
+    }
+    if (!listener) return;
+    for (uint8_t i = 0; i < count; i++) {
+        if (params[i] != NONE && params[i] < COUNT) listener(params[i]);
+    }
+}
+
+/**
+ * @param fn Called after a value changes, to push values that other objects
+ *           keep a copy of (e.g. servo limits, PID gains). Gets the Param that
+ *           changed, or NONE when they all may have.
+ */
+void Calibration::setListener(void (*fn)(uint8_t param)) {
+    listener = fn;
+}
+
+/**
+ * @param fn Called with the first two words of any Serial line that is not a
+ *           `cal` command (the second is null if there is none)
+ */
+void Calibration::setCommandHandler(void (*fn)(const char *command, const char *argument)) {
+    commandHandler = fn;
+}
+
+/**
+ * Read Serial commands, one per line:
+ *
+ *   cal                   list every value
+ *   cal DIST_ROOF         show one value
+ *   cal DIST_ROOF 10.6    change it (RAM only)
+ *   cal save              write the values to EEPROM
+ *   cal defaults          go back to the compiled defaults (RAM only)
+ *
+ * Other lines go to the command handler. Call periodically; never blocks.
+ */
+void Calibration::loop() {
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c == '\n' || c == '\r') {
+            if (lineLength == 0) continue;
+            line[lineLength] = 0;
+            lineLength = 0;
+            command(line);
+        } else if (lineLength < LINE_LENGTH - 1) {
+            line[lineLength++] = c;
+        }
+    }
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+void Calibration::command(char *text) {
+    char *word = strtok(text, " ");
+    if (!word) return;
+    if (strcmp(word, "cal")) {
+        if (commandHandler) commandHandler(word, strtok(0, " "));
+        return;
+    }
+
+    char *name = strtok(0, " ");
+    char *value = strtok(0, " ");
+    if (!name) {
+        for (uint8_t i = 1; i < COUNT; i++) print(i);
+    } else if (!strcmp(name, "save")) {
+        Serial.println(save() ? "Calibration saved" : "Calibration save failed");
+    } else if (!strcmp(name, "defaults")) {
+        resetToDefaults();
+        Serial.println("Calibration reset to defaults (not saved)");
+    } else {
+        int param = find(name);
+        if (param < 0) {
+            Serial.print("  || Unknown parameter: ");
+            Serial.println(name);
+            return;
+        }
+        if (value) set(param, atof(value));
+        print(param);
+    }
+}
+
+void Calibration::print(uint8_t param) {
+    char name[sizeof(paramNames[0])];
+    strcpy_P(name, paramNames[param]);
+    Serial.print("  || ");
+    Serial.print(name);
+    Serial.print(": ");
+    Serial.println(values[param], 4);
+}
+
+/**
+ * @return Param with this name, or -1
+ */
+int Calibration::find(const char *name) {
+    for (uint8_t i = 1; i < COUNT; i++) {
+        if (!strcmp_P(name, paramNames[i])) return i;
+    }
+    return -1;
+}
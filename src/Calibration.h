@@ -0,0 +1,81 @@
+#include <Arduino.h>
+
+#pragma once
+
+/**
+ * Field-tunable constants, kept in RAM and backed by a CRC-protected block in
+ * EEPROM. `load()` runs once in setup(); after that every read is a plain array
+ * access. Values can be listed, changed and saved over Serial (see `loop()`), so
+ * retuning a distance or a gripper position does not need a rebuild.
+ *
+ * Schema: parameters are only ever appended. A block saved by older firmware
+ * with fewer parameters still loads, and the new ones take their defaults.
+ * Bump CALIBRATION_VERSION only when an existing parameter changes meaning,
+ * which discards every saved block.
+ */
+class Calibration {
+    public:
+        enum Param {
+            NONE = 0,               // Reserved: "not calibrated" in mission steps
+            GRIPPER_OPEN,           // Servo microseconds
+            GRIPPER_CLOSED,
+            GEAR_RATIO_LIFTER,
+            LIFTER_PLATFORM,        // Arm degrees, multiplied by GEAR_RATIO_LIFTER for motor degrees
+            LIFTER_25ROOF,
+            LIFTER_45ROOF,
+            DIST_PLATFORM,          // Inches from the front of the robot with the wheels on the intersection
+            DIST_ROOF,
+            LIFTER_KP,              // BlueMotor::setGains()
+            LIFTER_KI,
+            LIFTER_KD,
+            LINE_LEFT_MIN,          // Line sensor readings over the table and over the tape (remote 8 measures them)
+            LINE_LEFT_MAX,
+            LINE_RIGHT_MIN,
+            LINE_RIGHT_MAX,
+            LIFTER_GRAVITY_0,       // BlueMotor::setGravity(), points 0 to 9 (remote 6 measures them)
+            LIFTER_GRAVITY_9 = LIFTER_GRAVITY_0 + 9,
+            COUNT
+        };
+
+        void load(const float *defaults);
+        bool save();
+        void loop();
+        void resetToDefaults();
+        void setListener(void (*fn)(uint8_t param));
+        void setCommandHandler(void (*fn)(const char *command, const char *argument));
+
+        /**
+         * @return Current value of `param`
+         */
+        float get(uint8_t param) {
+            return values[param];
+        }
+
+        void set(uint8_t param, float value);
+        void set(const uint8_t *params, const float *newValues, uint8_t count);
+
+    private:
+        struct __attribute__((packed)) Header {
+            uint8_t magic;
+            uint8_t version;
+            uint8_t count;          // Parameters stored after the header
+        };
+
+        static const uint8_t MAGIC = 0xCA;
+        static const uint8_t CALIBRATION_VERSION = 1;
+        static const int EEPROM_ADDRESS = 0;
+        static const uint8_t LINE_LENGTH = 40;
+
+        void command(char *line);
+        void print(uint8_t param);
+        int find(const char *name);
+
+        const float *defaults = 0;  // PROGMEM
+        void (*listener)(uint8_t param) = 0;
+        void (*commandHandler)(const char *command, const char *argument) = 0;
+        float values[COUNT];
+        char line[LINE_LENGTH];
+        uint8_t lineLength = 0;
+};
+
+extern Calibration calibration;
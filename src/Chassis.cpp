@@ -1,12 +1,18 @@
 #include <Arduino.h>
 #include "Chassis.h" 
+#include "Telemetry.h"
+#include "EStop.h"
 
 /**
  * Constructor for class Chassis
  */
-Chassis::Chassis() {
+Chassis::Chassis() : odometry(wheelDiameter, wheelTrack, CPR) {
     chassis_PID = PIDController(5.0, 0.1, 0.05);
-    line_PID = PIDController(0.1, 0.00, 0.01);
+    line_PID = PIDController(6.0, 0.0, 20.0);
+    turn_PID = PIDController(4.0, 0.0, 2.0);
+    left_PID = PIDController(6.0, 0.4, 0.0);
+    right_PID = PIDController(6.0, 0.4, 0.0);
+    turnProfile.setLimits(turnMaxVelocity, turnMaxAcceleration);
 }
 
 /**
@@ -14,23 +20,68 @@ Chassis::Chassis() {
  * @param effort Desired effort, 0 - 300.
  */
 void Chassis::drive(float effort) {
-    motors.setEfforts(effort, effort);
+    velocityControl = false;
+    lineFollowing = false;
+    setMotorEfforts(effort, effort);
 }
 
+/**
+ * Drive each wheel with a fixed effort, ending any `setVelocities()` control.
+ */
 void Chassis::setEfforts(float effortLeft, float effortRight) {
-    motors.setEfforts(effortLeft, effortRight);
+    velocityControl = false;
+    lineFollowing = false;
+    setMotorEfforts(effortLeft, effortRight);
 }
 
 void Chassis::setEffortsBoolean(bool effortLeft, bool effortRight) {
     if(effortLeft && !effortRight) {
-        motors.setEfforts(SPEED_VAL, 0);
+        setMotorEfforts(SPEED_VAL, 0);
     } else if(!effortLeft && effortRight) {
-        motors.setEfforts(0, SPEED_VAL);
+        setMotorEfforts(0, SPEED_VAL);
     } else if(effortLeft, effortRight) {
-        motors.setEfforts(SPEED_VAL, SPEED_VAL);
+        setMotorEfforts(SPEED_VAL, SPEED_VAL);
     } else if(!effortLeft && !effortRight) {
-        motors.setEfforts(0, 0);     
+        setMotorEfforts(0, 0);     
+    }
+}
+
+/**
+ * Hold each wheel at a speed with its own velocity PID. Non-blocking: call
+ * `loopVelocity()` at a fixed rate. Calling again just moves the setpoints, so it
+ * is safe to re-apply every loop. `drive()` or `setEfforts()` hands the wheels back
+ * to open-loop effort.
+ * @param left Left wheel speed in inches per second, positive forward
+ * @param right Right wheel speed in inches per second, positive forward
+ */
+void Chassis::setVelocities(float left, float right) {
+    if(!velocityControl) {
+        left_PID.reset();
+        right_PID.reset();
     }
+    targetLeft = left;
+    targetRight = right;
+    turning = false;
+    lineFollowing = false;
+    velocityControl = true;
+}
+
+/**
+ * Accompanying function to `setVelocities()` that runs one step of both wheel loops
+ * against the odometry wheel speeds. The scheduler runs it at 100Hz while
+ * `isVelocityControlled()`.
+ */
+void Chassis::loopVelocity() {
+    if(!velocityControl) return;
+    setMotorEfforts(wheelEffort(left_PID, targetLeft, odometry.getLeftVelocity()),
+                      wheelEffort(right_PID, targetRight, odometry.getRightVelocity()));
+}
+
+/**
+ * @return True between `setVelocities()` and the next open-loop command
+ */
+bool Chassis::isVelocityControlled() {
+    return velocityControl;
 }
 
 /** 
@@ -38,15 +89,17 @@ void Chassis::setEffortsBoolean(bool effortLeft, bool effortRight) {
  * @param inches Desired distance to drive.
  */ 
 void Chassis::driveDistance(float inches) {
-    encoders.getCountsAndResetLeft(); // Reset encoders
-    encoders.getCountsAndResetRight();
+    long startLeft = odometry.getLeftCounts();
+    long startRight = odometry.getRightCounts();
 
     float countSetpoint = inches * (Chassis::CPR / (Chassis::wheelDiameter * (PI)));
 
-    while((abs(encoders.getCountsLeft()) < countSetpoint) && (abs(encoders.getCountsRight()) < countSetpoint)) {
-        motors.setEfforts(SPEED_VAL, SPEED_VAL);
+    while((abs(odometry.getLeftCounts() - startLeft) < countSetpoint) && (abs(odometry.getRightCounts() - startRight) < countSetpoint)) {
+        setMotorEfforts(SPEED_VAL, SPEED_VAL);
+        odometry.update();
+        delay(10);
     }
-    motors.setEfforts(0, 0); // Stop after completion
+    setMotorEfforts(0, 0); // Stop after completion
 } 
 
 /**
@@ -55,45 +108,43 @@ void Chassis::driveDistance(float inches) {
  * @param ultraInput Ultrasonic sensor reading, in inches
  */
 void Chassis::startUltraDrive(float inches, float ultraInput) {
+    chassis_PID.reset();
     chassis_PID.setSetpoint(inches);
-    float eff = chassis_PID.calculateEffort(ultraInput);
-
-    if(eff > 0 && abs(eff) < SPEED_VAL) { // + effort; below max
-        drive(eff);
-    } else if(eff > 0 && abs(eff) > SPEED_VAL) { // + effort; above max
-        drive(SPEED_VAL);
-    } else if(eff < 0 && abs(eff) < SPEED_VAL) { // - effort; below max
-        drive(eff);
-    } else if(eff < 0 && abs(eff) > SPEED_VAL) { // - effort; above max
-        drive(-SPEED_VAL);
-    }
-    delay(10); // 100Hz controller
+    ultraDriving = true;
+    drive(chassis_PID.calculateEffort(ultraInput)); // Saturates at SPEED_VAL
 }
 
 /**
- * Accompanying function to `startUltraDrive` that runs the PID algorithm
+ * Accompanying function to `startUltraDrive` that runs one step of the PID algorithm.
+ * Call at a fixed rate; the scheduler runs it at 100Hz while `isUltraDriving()`.
  */
 void Chassis::loopUltraPID(float ultraInput) {
     if(!chassis_PID.onTarget(ultraInput)) {
         float eff = chassis_PID.calculateEffort(ultraInput);
-        Serial.println(eff);
-        
-        if(eff > 0 && abs(eff) < SPEED_VAL) { // + effort; below max
-            drive(eff);
-        } else if(eff > 0 && abs(eff) > SPEED_VAL) { // + effort; above max
-            drive(SPEED_VAL);
-        } else if(eff < 0 && abs(eff) < SPEED_VAL) { // - effort; below max
-            drive(eff);
-        } else if(eff < 0 && abs(eff) > SPEED_VAL) { // - effort; above max
-            drive(-SPEED_VAL);
-        }
-
-        delay(10); // 100Hz controller
+        telemetry.send(Telemetry::CHASSIS, ultraInput, chassis_PID.getSetpoint(), eff,
+                       (int)eff, 0, chassis_PID.getGainValue(1),
+                       chassis_PID.getGainValue(2), chassis_PID.getGainValue(3));
+        drive(eff);
     } else {
         drive(0);
     }
 }
 
+/**
+ * Stop the ultrasonic drive started by `startUltraDrive()`
+ */
+void Chassis::stopUltraDrive() {
+    ultraDriving = false;
+    drive(0);
+}
+
+/**
+ * @return True between `startUltraDrive()` and `stopUltraDrive()`
+ */
+bool Chassis::isUltraDriving() {
+    return ultraDriving;
+}
+
 /**
  * Pull the PID onTarget status from the local PIDController instance
  * @param ultraInput Ultrasonic sensor reading, in inches
@@ -104,19 +155,53 @@ bool Chassis::pullOnTarget(float ultraInput) {
 }
 
 /**
- * Follow a black line with PID control to the chassis 
+ * Follow the tape forward at `speed`. Non-blocking: call `loopLineFollow()` at a
+ * fixed rate with the tick's line estimate. Calling again just changes the speed,
+ * so it is safe to re-apply every loop; any other drive command ends it.
+ * @param speed Wheel speed on a straight, inches per second
  */
-void Chassis::startLinePID(float lineLeftInput, float lineRightInput) {
-    float leftDiff = lineLeftInput - lineRightInput;
-    float rightDiff = lineLeftInput + lineRightInput;
-    //line_PID.setSetpoint(1); // FIXME: find a target threshold
-    //float eff = line_PID.calculateEffort();
+void Chassis::startLineFollow(float speed) {
+    if(!lineFollowing) {
+        line_PID.reset();
+        setVelocities(speed, speed);
+    }
+    lineSpeed = speed;
+    lineFollowing = true;
+}
 
-    setEfforts(leftDiff * line_PID.getGainValue(1), rightDiff * line_PID.getGainValue(1));
+/**
+ * Accompanying function to `startLineFollow()` that steers the wheel velocity
+ * loops toward the tape. The scheduler runs it at 100Hz while `isLineFollowing()`,
+ * like every other controller: it acts only through the wheel loops, which close
+ * on odometry sampled once per tick, so running it faster would gain nothing.
+ * Slows down in proportion to how far
+ * off the tape the robot is, and drives straight while the tape is lost.
+ * @param offset Tape position from the sensor frame, -1 (right) to 1 (left)
+ * @param confidence From the sensor frame, 0 to 1
+ */
+void Chassis::loopLineFollow(float offset, float confidence) {
+    if(!lineFollowing) return;
 
-    if(lineLeftInput < 800 && lineRightInput < 800) { // Detect an intersection and stop
-        drive(0);
+    float steer = 0;
+    float forward = lineSpeed;
+    if(confidence >= lineMinConfidence) {
+        steer = line_PID.calculateEffort(offset);
+        forward *= 1.0 - lineSlowdown * abs(offset);
+    } else {
+        line_PID.reset(); // No derivative kick when the tape comes back
     }
+    targetLeft = forward - steer;
+    targetRight = forward + steer;
+    telemetry.send(Telemetry::LINE_FOLLOW, offset, 0, steer, 0, confidence * 100 + 0.5, line_PID.getGainValue(1),
+                   line_PID.getGainValue(2), line_PID.getGainValue(3));
+    loopVelocity();
+}
+
+/**
+ * @return True between `startLineFollow()` and the next other drive command
+ */
+bool Chassis::isLineFollowing() {
+    return lineFollowing;
 }
 
 /** 
@@ -125,48 +210,145 @@ void Chassis::startLinePID(float lineLeftInput, float lineRightInput) {
  * @param degrees Desired angle to turn.
  */ 
 void Chassis::turnAngle(float degrees) {     
-    encoders.getCountsAndResetLeft(); // Reset encoders
-    encoders.getCountsAndResetRight();
-
-    float countSetpoint = ( ((degrees/360) * Chassis::wheelTrack) * (Chassis::CPR / Chassis::wheelDiameter) );
-
-    while((abs(encoders.getCountsLeft()) < countSetpoint) && (abs(encoders.getCountsRight()) < countSetpoint)) {
-        if(degrees > 0) motors.setEfforts(SPEED_VAL, -SPEED_VAL); else motors.setEfforts(-SPEED_VAL, SPEED_VAL);
+    startTurn(degrees);
+    while(!turnComplete()) {
+        odometry.update();
+        loopTurn();
+        delay(10);
     }
-    motors.setEfforts(0, 0); // Stop after completion
 } 
 
 /**
- * Start a turn going to "degrees". This is non-blocking and sets the motor
- * speeds to a value for making the turn. Must be called once. Call turnComplete() to know
- * if the turn has reached the "degrees" goal.
+ * Start a turn in place going to "degrees". This is non-blocking: call `loopTurn()`
+ * at a fixed rate until `turnComplete()`. The turn follows a trapezoidal profile
+ * on heading, with a PID on the odometry heading tracking it.
  * @param degrees Desired angle to turn - positive is clockwise
  */
-int finalTurnCount;
-bool clockwise = true;
 void Chassis::startTurn(float degrees) {
-    finalTurnCount = abs(degrees) * CPR * wheelTrack / (360.0 * wheelDiameter);
-    encoders.getCountsAndResetLeft();
-    encoders.getCountsAndResetRight();
-    if(degrees > 0) {
-        clockwise = true;
-        motors.setEfforts(SPEED_VAL, -SPEED_VAL); 
-    } else { 
-        clockwise = false;
-        motors.setEfforts(-SPEED_VAL, SPEED_VAL);
+    turnStartHeading = odometry.getHeadingDegrees();
+    turnProfile.start(0, degrees);
+    turn_PID.reset();
+    turn_PID.setSetpoint(0);
+    settledCount = 0;
+    lineFollowing = false;
+    turning = true;
+}
+
+/**
+ * Pick up after an E-stop pause: a turn starts its profile again from the angle
+ * already turned, since the profile's clock ran on through the pause, and every
+ * controller drops the history it had from before the pause.
+ */
+void Chassis::resume() {
+    if(turning) {
+        turnProfile.start(turnedAngle(), turnProfile.getTarget());
+        settledCount = 0;
+    }
+    turn_PID.reset();
+    chassis_PID.reset();
+    line_PID.reset();
+    left_PID.reset();
+    right_PID.reset();
+}
+
+/**
+ * Accompanying function to `startTurn()` that runs one step of the heading controller.
+ * Call at a fixed rate; the scheduler runs it at 100Hz while `isTurning()`.
+ */
+void Chassis::loopTurn() {
+    if(!turning) return;
+
+    float turned = turnedAngle();
+    turn_PID.setSetpoint(turnProfile.getSetpoint());
+
+    if(turnProfile.isComplete() && turn_PID.onTarget(turned)) {
+        // Settled once the heading has stayed in tolerance with the wheels nearly stopped
+        float rate = (odometry.getLeftVelocity() - odometry.getRightVelocity()) / wheelTrack * (180.0 / PI);
+        if(abs(rate) <= turnSettledRate) settledCount++;
+        else settledCount = 0;
+        if(settledCount >= turnSettledTicks) turning = false;
+        setEfforts(0, 0);
+        return;
     }
+
+    settledCount = 0;
+    float PIDOut = turn_PID.calculateEffort(turned);
+    float effort = turnVelocityFF * turnProfile.getVelocity() - PIDOut;
+    if(effort > 0) effort += wheelMinEffort;
+    else if(effort < 0) effort -= wheelMinEffort;
+    effort = constrain(effort, -SPEED_VAL * 2, SPEED_VAL * 2);
+    setEfforts(effort, -effort);
+}
+
+/**
+ * @return True between `startTurn()` and the turn settling
+ */
+bool Chassis::isTurning() {
+    return turning;
 }
 
 /**
  * Accompanying method to `startTurn()` to be called in a loop after starting the turn.
- * @return true if a turn started with startTurn() has completed
+ * @return true once the turn has settled on the commanded angle
  */
 bool Chassis::turnComplete() {
-    if (clockwise) motors.setEfforts(SPEED_VAL, -SPEED_VAL); else motors.setEfforts(-SPEED_VAL, SPEED_VAL);
-    bool retVal = (abs(encoders.getCountsLeft()) >= finalTurnCount) && (abs(encoders.getCountsRight()) >= finalTurnCount);
-    return retVal;
+    return !turning;
+}
+
+/**
+ * Sample the wheel encoders into the pose estimate. Call at a fixed rate; the
+ * scheduler runs it at 100Hz.
+ */
+void Chassis::updateOdometry() {
+    odometry.update();
+}
+
+/**
+ * @return The shared pose estimate, for reading pose and wheel velocities
+ */
+Odometry &Chassis::getOdometry() {
+    return odometry;
 }
 
 void Chassis::setup() {
     chassis_PID.setTolerance(tolerance);
-}
\ No newline at end of file
+    chassis_PID.setOutputLimit(SPEED_VAL);
+    chassis_PID.setDerivativeFilter(ultraFilter);
+    turn_PID.setTolerance(turnTolerance);
+    left_PID.setOutputLimit(300);
+    right_PID.setOutputLimit(300);
+    line_PID.setOutputLimit(lineMaxSteer);
+    odometry.setup();
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+/**
+ * @return Degrees turned since `startTurn()`, clockwise positive
+ */
+float Chassis::turnedAngle() {
+    return turnStartHeading - odometry.getHeadingDegrees();
+}
+
+/**
+ * Feedforward plus PID effort for one wheel
+ * @param pid That wheel's velocity PID
+ * @param target Setpoint, inches per second
+ * @param measured Odometry wheel speed, inches per second
+ */
+float Chassis::wheelEffort(PIDController &pid, float target, float measured) {
+    pid.setSetpoint(target);
+    float effort = wheelVelocityFF * target - pid.calculateEffort(measured);
+    if(target > 0) effort += wheelMinEffort;
+    else if(target < 0) effort -= wheelMinEffort;
+    return constrain(effort, -300, 300);
+}
+
+/**
+ * Every drive motor write goes through here, so nothing can restart the wheels
+ * while the E-stop is latched
+ */
+void Chassis::setMotorEfforts(int16_t left, int16_t right) {
+    motors.setEfforts(left, right);
+    if(estop.isTripped()) motors.setEfforts(0, 0); // Checked after the write, so a trip that lands mid-update still wins
+}
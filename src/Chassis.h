@@ -1,5 +1,7 @@
 #include <Romi32U4.h>
 #include "PIDController.h"
+#include "Odometry.h"
+#include "MotionProfile.h"
 
 #pragma once
 
@@ -9,14 +11,26 @@ class Chassis {
         void drive(float effort);
         void setEfforts(float effortLeft, float effortRight);
         void setEffortsBoolean(bool effortLeft, bool effortRight);
+        void setVelocities(float left, float right);
+        void loopVelocity();
+        bool isVelocityControlled();
         void driveDistance(float inches);
         void startUltraDrive(float inches, float ultraInput); 
         void loopUltraPID(float ultraInput);
+        void stopUltraDrive();
+        bool isUltraDriving();
         bool pullOnTarget(float ultraInput);
-        void startLinePID(float lineLeftInput, float lineRightInput);
+        void startLineFollow(float speed);
+        void loopLineFollow(float offset, float confidence);
+        bool isLineFollowing();
         void turnAngle(float degrees);
         void startTurn(float degrees);
+        void loopTurn();
+        void resume();
+        bool isTurning();
         bool turnComplete();
+        void updateOdometry();
+        Odometry &getOdometry();
         void setup();
         
         const int SPEED_VAL = 60;          // Default driving speed for chassis commands
@@ -26,11 +40,45 @@ class Chassis {
         
     private:     
         Romi32U4Motors motors;     
-        Romi32U4Encoders encoders; 
+        Odometry odometry;
         PIDController chassis_PID;
         PIDController line_PID;
+        PIDController turn_PID;
+        PIDController left_PID;
+        PIDController right_PID;
+        MotionProfile turnProfile;
 
         const float tolerance = 0.3;
-        const float tolerance_line = 0.02;
+        const float ultraFilter = 0.05;         // Seconds; the range is only fresh every few ticks
+        bool ultraDriving = false;
+
+        float turnedAngle();
+        float wheelEffort(PIDController &pid, float target, float measured);
+        void setMotorEfforts(int16_t left, int16_t right);
+
+        const float turnMaxVelocity = 120.0;    // Degrees per second
+        const float turnMaxAcceleration = 480.0;// Degrees per second squared
+        const float turnVelocityFF = 0.65;      // Effort per degree per second of profile velocity
+        const float turnTolerance = 1.0;        // Degrees
+        const float turnSettledRate = 5.0;      // Degrees per second
+        const uint8_t turnSettledTicks = 5;     // Consecutive in-tolerance loops before the turn is done
+
+        const float wheelVelocityFF = 13.0;     // Effort per inch per second
+        const float wheelMinEffort = 15.0;      // Effort below which the wheels do not turn
+
+        const float lineMaxSteer = 4.0;         // Largest wheel speed difference either side of lineSpeed, in/s
+        const float lineSlowdown = 0.5;         // Fraction of lineSpeed shed with the tape at a sensor
+        const float lineMinConfidence = 0.2;    // Below this the tape is lost and the robot drives straight
+
+        float lineSpeed = 0.0;      // Inches per second
+        bool lineFollowing = false;
+
+        float targetLeft = 0.0;     // Wheel velocity setpoints, inches per second
+        float targetRight = 0.0;
+        bool velocityControl = false;
+
+        float turnStartHeading = 0.0;   // Odometry heading when the turn started, degrees
+        bool turning = false;
+        uint8_t settledCount = 0;
 
 };
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <Arduino.h>
+#include "EStop.h"
+#include "HAL.h"
+#include "EventQueue.h"
+
+EStop estop;
+
+/**
+ * @param decoder Remote decoder, already initialised
+ * @param stopKey Key code that trips the stop
+ */
+void EStop::setup(IRDecoder &decoder, uint8_t stopKey) {
+    this->decoder = &decoder;
+    this->stopKey = stopKey;
+}
+
+/**
+ * Take any decoded key. Runs in interrupt context every scheduler tick. A fresh
+ * press of the stop key trips the stop while armed; every other key, and a fresh
+ * stop key press that does not trip, is posted as a KEY event for the main loop.
+ * Repeats of a held stop key are dropped.
+ */
+void EStop::poll() {
+    unsigned long now = micros();
+    if (lastPoll && now - lastPoll > maxPollGap) maxPollGap = now - lastPoll;
+    lastPoll = now;
+
+    if (!decoder) return;
+    int16_t key = decoder->getKeyCode(true);
+    if (key < 0) return;
+    if (key == stopKey) {
+        unsigned long ms = millis();
+        bool repeat = ms - lastStopKey < RELEASE_MS;
+        lastStopKey = ms;
+        if (repeat) return;
+        if (tripped) pressedAgain = true;
+    }
+    if (key != stopKey || !armed || tripped) {
+        events.post(Event::KEY, key, now);
+        return;
+    }
+
+    cutOutputs();
+    unsigned long cut = micros() - now;
+    if (cut > maxCutMicros) maxCutMicros = cut;
+}
+
+/**
+ * Trip from the main loop, e.g. when the key arrived while the stop was disarmed
+ */
+void EStop::trip() {
+    noInterrupts();
+    if (!tripped) cutOutputs();
+    interrupts();
+}
+
+/**
+ * Release the latch, but only once the stop key has been released and pressed
+ * again since the trip
+ * @return True if cleared
+ */
+bool EStop::clear() {
+    if (!pressedAgain) return false;
+    pressedAgain = false;
+    tripped = false;
+    return true;
+}
+
+/**
+ * @param armed False to leave the stop key to the main loop, e.g. while it
+ *              confirms a mission step. `trip()` still works.
+ */
+void EStop::setArmed(bool armed) {
+    this->armed = armed;
+}
+
+/**
+ * @return True once after each trip
+ */
+bool EStop::takeTripEvent() {
+    noInterrupts();
+    bool event = tripEvent;
+    tripEvent = false;
+    interrupts();
+    return event;
+}
+
+/**
+ * Print trip count and the measured worst-case reaction
+ */
+void EStop::report() {
+    noInterrupts();
+    unsigned long gap = maxPollGap;
+    unsigned long cut = maxCutMicros;
+    uint16_t count = trips;
+    interrupts();
+
+    Serial.print("E-stop  || Trips: ");
+    Serial.print(count);
+    Serial.print("  || Max poll gap us: ");
+    Serial.print(gap);
+    Serial.print("  || Max cut us: ");
+    Serial.print(cut);
+    Serial.print("  || Worst-case reaction us: ");
+    Serial.println(gap + cut);
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+/**
+ * Zero every motor output and latch. Interrupts must be off.
+ */
+void EStop::cutOutputs() {
+    Romi32U4Motors::setEfforts(0, 0);
+    halLifterPWM(0);
+    tripped = true;
+    tripEvent = true;
+    pressedAgain = false;
+    tripMillis = millis();
+    lastStopKey = tripMillis;   // The press that tripped, when it came from the key
+    trips++;
+}
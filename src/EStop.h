@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include <Romi32U4.h>
+#include "IRdecoder.h"
+
+#pragma once
+
+/**
+ * Remote E-stop that does not wait for the main loop. `poll()` runs in the
+ * scheduler's timer interrupt, so however long a task or a blocking call takes,
+ * a decoded stop key is seen within one tick (~1ms). It reads every key, so the
+ * others reach the main loop as KEY events (EventQueue.h) instead. Tripping zeroes both drive
+ * motors and the lifter PWM (OCR1C) on the spot and latches: Chassis, BlueMotor
+ * and Mission check `isTripped()` and hold their outputs at zero until `clear()`,
+ * after which main.cpp has each of them `resume()`.
+ *
+ * A held key repeats its code about every 110ms. Codes closer together than
+ * RELEASE_MS are taken as one press and swallowed, so holding the stop key can
+ * neither clear the latch nor confirm a step over and over; clearing takes the
+ * key being released and pressed again.
+ *
+ * The worst-case reaction, from the IR frame being decoded to the outputs being
+ * cut, is the longest gap between polls plus the cut itself; both are measured
+ * and printed by `report()`.
+ */
+class EStop {
+    public:
+        void setup(IRDecoder &decoder, uint8_t stopKey);
+        void poll();
+        void trip();
+        bool clear();
+        void setArmed(bool armed);
+        void report();
+
+        /**
+         * @return True from a trip until `clear()`
+         */
+        bool isTripped() {
+            return tripped;
+        }
+
+        /**
+         * @return millis() of the last trip; `clear()` callers use it to make up for the pause
+         */
+        unsigned long getTripMillis() {
+            return tripMillis;
+        }
+
+        bool takeTripEvent();
+
+    private:
+        static const unsigned long RELEASE_MS = 200;    // Quiet time that ends a press (repeats come every ~110ms)
+
+        void cutOutputs();
+
+        IRDecoder *decoder = 0;
+        uint8_t stopKey = 0;
+        volatile bool tripped = false;
+        volatile bool tripEvent = false;        // Set on each trip, taken by the main loop to announce it
+        volatile bool armed = true;             // False while the stop key means something else (CONFIRM steps)
+        unsigned long lastStopKey = 0;          // millis() of the last stop key code, repeats included
+        unsigned long tripMillis = 0;
+        volatile bool pressedAgain = false;     // A fresh stop key press since the trip
+        unsigned long lastPoll = 0;             // micros()
+        volatile unsigned long maxPollGap = 0;  // Longest time the key could go unseen, us
+        volatile unsigned long maxCutMicros = 0;
+        volatile uint16_t trips = 0;
+};
+
+extern EStop estop;
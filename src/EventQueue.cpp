@@ -0,0 +1,47 @@
+#include <Arduino.h>
+#include "EventQueue.h"
+
+EventQueue events;
+
+// Stops the compiler moving slot accesses across an index update. The AVR core
+// executes in order, so nothing more is needed.
+#define COMPILER_BARRIER() asm volatile("" ::: "memory")
+
+/**
+ * Queue an event. Call only from interrupt context (or with interrupts off).
+ * @return False if the ring was full and the event was dropped
+ */
+bool EventQueue::post(Event::Type type, uint32_t value, uint32_t micros) {
+    uint8_t h = head;
+    uint8_t next = (h + 1) & (LENGTH - 1);
+    if (next == tail) {
+        dropped++;
+        return false;
+    }
+    events[h] = {type, value, micros};
+    COMPILER_BARRIER();
+    head = next;    // Publishes the slot
+    return true;
+}
+
+/**
+ * Take the oldest event. Call only from the main loop; drain with
+ * `while (events.pop(e))`.
+ * @return False if there was none
+ */
+bool EventQueue::pop(Event &event) {
+    uint8_t t = tail;
+    if (t == head) return false;
+    COMPILER_BARRIER();
+    event = events[t];
+    COMPILER_BARRIER();
+    tail = (t + 1) & (LENGTH - 1);  // Frees the slot
+    return true;
+}
+
+/**
+ * @return Events lost to a full ring since boot
+ */
+uint16_t EventQueue::getDropped() {
+    return dropped;     // 16 bits, so only an estimate if read mid-update
+}
@@ -0,0 +1,45 @@
+#include <Arduino.h>
+
+#pragma once
+
+/**
+ * Something an interrupt saw, for the main loop to act on. Only events that must
+ * each be handled go through the ring; anything that can repeat faster than the
+ * main loop drains it (e.g. lifter encoder faults) is counted where it happens
+ * and read from there, so it can never crowd out a key press.
+ */
+struct Event {
+    enum Type : uint8_t {
+        ECHO,               // value = ultrasonic round trip, us
+        KEY                 // value = IR remote key code
+    };
+
+    Type type;
+    uint32_t value;
+    uint32_t micros;        // When the interrupt saw it
+};
+
+/**
+ * Lock-free single-producer, single-consumer ring from interrupt context to the
+ * main loop. Interrupts on the 32U4 never nest, so every ISR together counts as
+ * the one producer, and the main loop is the one consumer. The indices are one
+ * byte each, so reading one is atomic. Each side writes only its own index, and
+ * only after the slot it guards is complete, so neither side ever turns
+ * interrupts off. When the ring is full, new events are dropped and counted.
+ */
+class EventQueue {
+    public:
+        bool post(Event::Type type, uint32_t value, uint32_t micros);
+        bool pop(Event &event);
+        uint16_t getDropped();
+
+    private:
+        static const uint8_t LENGTH = 8;    // Power of two; one slot is always left empty
+
+        Event events[LENGTH];
+        volatile uint8_t head = 0;          // Next slot to write; producer only
+        volatile uint8_t tail = 0;          // Next slot to read; consumer only
+        volatile uint16_t dropped = 0;
+};
+
+extern EventQueue events;
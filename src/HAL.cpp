@@ -0,0 +1,113 @@
+#ifndef ROMI_SIM
+
+#include <Arduino.h>
+#include "HAL.h"
+
+static void (*tickHandler)() = 0;
+
+void halStartTick(void (*fn)()) {
+    tickHandler = fn;
+    OCR0B = 128;            // Half way through each millis() period, away from the overflow ISR
+    TIFR0 = _BV(OCF0B);     // Drop any stale compare flag
+    TIMSK0 |= _BV(OCIE0B);
+}
+
+ISR(TIMER0_COMPB_vect) {
+    if (tickHandler) tickHandler();
+}
+
+// ADC sampler. The ISR fills the back buffer and flips `adcFront` after the last
+// channel; `adcRound` lets a reader detect a flip that happened mid-copy.
+static uint8_t adcChannels[HAL_ADC_MAX_CHANNELS];
+static uint8_t adcCount = 0;
+static uint8_t adcIndex = 0;
+static volatile uint16_t adcBuffers[2][HAL_ADC_MAX_CHANNELS];
+static volatile uint8_t adcFront = 0;
+static volatile uint8_t adcRound = 0;
+static volatile bool adcReady = false;
+
+static inline void adcSelect(uint8_t channel) {
+    ADMUX = _BV(REFS0) | (channel & 0x07);  // AVcc reference
+    ADCSRB = (ADCSRB & ~_BV(MUX5)) | ((channel & 0x08) ? _BV(MUX5) : 0);
+}
+
+void halAdcStart(const uint8_t *pins, uint8_t count) {
+    if (count > HAL_ADC_MAX_CHANNELS) count = HAL_ADC_MAX_CHANNELS;
+    if (count == 0) return;
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t pin = pins[i];
+        if (pin >= 18) pin -= 18;   // Same mapping as analogRead()
+        adcChannels[i] = analogPinToChannel(pin);
+    }
+    adcCount = count;
+    adcIndex = 0;
+    adcReady = false;
+
+    adcSelect(adcChannels[0]);
+    // Each conversion is started from the ISR of the previous one, so the mux can
+    // be switched safely in between. Prescaler 128: 125kHz ADC clock.
+    ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADSC) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+bool halAdcRead(uint16_t *values) {
+    uint8_t round;
+    do {
+        round = adcRound;
+        uint8_t front = adcFront;
+        for (uint8_t i = 0; i < adcCount; i++) values[i] = adcBuffers[front][i];
+    } while (round != adcRound);
+    return adcReady;
+}
+
+ISR(ADC_vect) {
+    adcBuffers[adcFront ^ 1][adcIndex] = ADC;
+    if (++adcIndex >= adcCount) {
+        adcIndex = 0;
+        adcFront ^= 1;
+        adcRound++;
+        adcReady = true;
+    }
+    adcSelect(adcChannels[adcIndex]);
+    ADCSRA |= _BV(ADSC);
+}
+
+// Stack painting. The canary fill runs in .init1, before the C runtime has even
+// set up the stack pointer, so it is plain assembly with no stack use of its own.
+static const uint8_t STACK_CANARY = 0xC5;
+extern uint8_t _end;            // End of .bss: the heap starts here
+extern uint8_t __stack;         // Top of SRAM
+extern char *__brkval;          // Top of the heap, 0 until malloc() is first used
+
+void halStackPaint() __attribute__((naked, used, section(".init1")));
+void halStackPaint() {
+    __asm volatile (
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, 0xC5\n"         // STACK_CANARY
+        "    ldi r25, hi8(__stack)\n"
+        "    rjmp 2f\n"
+        "1:  st Z+, r24\n"
+        "2:  cpi r30, lo8(__stack)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+        "    breq 1b\n"
+        ::);
+}
+
+uint16_t halStackUnused() {
+    const uint8_t *p = __brkval ? (const uint8_t *)__brkval : &_end;
+    uint16_t unused = 0;
+    while (p <= &__stack && *p == STACK_CANARY) {
+        p++;
+        unused++;
+    }
+    return unused;
+}
+
+uint16_t halFreeRam() {
+    uint8_t top;    // Lives at the current stack pointer
+    return &top - (__brkval ? (uint8_t *)__brkval : &_end);
+}
+
+#endif
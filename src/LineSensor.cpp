@@ -1,14 +1,18 @@
 #include <Arduino.h>
 #include "LineSensor.h"
+#include "Telemetry.h"
+#include "HAL.h"
 
 void LineSensor::setup() {
     pinMode(leftSensorPin, INPUT);  // Left sensor
     pinMode(rightSensorPin, INPUT);  // Right sensor (blue motor side)
+
+    const uint8_t pins[SENSOR_COUNT] = {leftSensorPin, rightSensorPin};
+    halAdcStart(pins, SENSOR_COUNT);
 }
 
 void LineSensor::loop() {
-    senseLeftOut = analogRead(leftSensorPin);
-    senseRightOut = analogRead(rightSensorPin);
+    update();
 
     // Serial.print("Sensor 1: ");
     // Serial.print(senseLeftOut);
@@ -17,14 +21,109 @@ void LineSensor::loop() {
 }
 
 /**
- * Read the sensor values and return them
+ * Fill in the line sensor part of the tick's sensor frame: the raw readings and
+ * where the tape is under the sensors. Both sensors are scaled to 0 (table) - 1
+ * (tape) with their calibrated ranges; the offset is how much more of the tape
+ * the left sensor sees than the right, so it is linear while the tape is
+ * between them and saturates at +/-1 once one sensor loses it. The confidence
+ * is the stronger of the two readings. Below MIN_CONFIDENCE the tape is lost
+ * and the offset keeps its last value, which says which side it went.
+ */
+void LineSensor::sample(SensorFrame &frame) {
+    update();
+    if (calibrating) {
+        if (senseLeftOut < leftMin) leftMin = senseLeftOut;
+        if (senseLeftOut > leftMax) leftMax = senseLeftOut;
+        if (senseRightOut < rightMin) rightMin = senseRightOut;
+        if (senseRightOut > rightMax) rightMax = senseRightOut;
+    }
+
+    float left = normalize(senseLeftOut, leftMin, leftMax);
+    float right = normalize(senseRightOut, rightMin, rightMax);
+    confidence = (left > right) ? left : right;
+    if (confidence >= MIN_CONFIDENCE) offset = (left - right) / (left + right);
+    if (!calibrating) detectIntersection(left, right);
+
+    frame.lineLeft = senseLeftOut;
+    frame.lineRight = senseRightOut;
+    frame.lineOffset = offset;
+    frame.lineConfidence = confidence;
+    frame.intersections = intersections;
+}
+
+/**
+ * Start recording each sensor's lowest and highest reading. Sweep both sensors
+ * across the tape (remote 8 spins the robot in place over it), then call
+ * `finishCalibration()`.
+ */
+void LineSensor::startCalibration() {
+    leftMin = rightMin = 1023;
+    leftMax = rightMax = 0;
+    calibrating = true;
+}
+
+/**
+ * Stop recording. If either sensor saw less than MIN_SPAN between table and
+ * tape, it probably never crossed the tape, and the ranges from before the
+ * calibration are kept.
+ * @return True if the new ranges were kept
+ */
+bool LineSensor::finishCalibration() {
+    calibrating = false;
+    if (leftMax - leftMin >= MIN_SPAN && rightMax - rightMin >= MIN_SPAN) return true;
+    setRange(true, savedLeftMin, savedLeftMax);
+    setRange(false, savedRightMin, savedRightMax);
+    return false;
+}
+
+bool LineSensor::isCalibrating() {
+    return calibrating;
+}
+
+/**
+ * @param left True for the left sensor
+ * @param min Reading over the table
+ * @param max Reading over the tape
+ */
+void LineSensor::setRange(bool left, int min, int max) {
+    if (left) {
+        leftMin = savedLeftMin = min;
+        leftMax = savedLeftMax = max;
+    } else {
+        rightMin = savedRightMin = min;
+        rightMax = savedRightMax = max;
+    }
+}
+
+/**
+ * @return Calibrated reading over the table
+ */
+int LineSensor::pullMin(bool left) {
+    return left ? leftMin : rightMin;
+}
+
+/**
+ * @return Calibrated reading over the tape
+ */
+int LineSensor::pullMax(bool left) {
+    return left ? leftMax : rightMax;
+}
+
+/**
+ * @return True if the sensor's last reading is nearer its tape reading than its table reading
+ */
+bool LineSensor::onLine(bool left) {
+    return left ? normalize(senseLeftOut, leftMin, leftMax) >= 0.5 : normalize(senseRightOut, rightMin, rightMax) >= 0.5;
+}
+
+/**
+ * Return the latest sensor value. Both sides come from the same pass of the
+ * background ADC sampler, so this never waits on a conversion.
  * @param left A boolean value indicating left sensor or right sensor
  * @return Integer reading from sensor, 0 - 1023.
  */
 int LineSensor::readSensor(bool left) {
-    senseLeftOut = analogRead(leftSensorPin);
-    senseRightOut = analogRead(rightSensorPin);
-
+    update();
     return (left) ? senseLeftOut : senseRightOut;
 }
 
@@ -33,51 +132,34 @@ int LineSensor::readSensor(bool left) {
  * @author Jack Bergin
  */
 void LineSensor::setLineFollowForward() {
-    int left_sensor_state = readSensor(true);
-    int right_sensor_state = readSensor(false);
-
-  if(right_sensor_state < 500 && left_sensor_state > 500){
-    Serial.println("turning right");
-    Serial.println(right_sensor_state);
-    Serial.println(left_sensor_state);
-    Serial.println("------------------");
+    update(); // One coherent pair for both decisions
+    bool left_on_line = onLine(true);
+    bool right_on_line = onLine(false);
 
+  if(!right_on_line && left_on_line){
     leftDrive = true;
     rightDrive = false;
     //delay(10);
   }
-  if(right_sensor_state > 500 && left_sensor_state < 500){
-    Serial.println("turning left");
-    Serial.println(right_sensor_state);
-    Serial.println(left_sensor_state);
-    Serial.println("------------------");   
-
+  if(right_on_line && !left_on_line){
     leftDrive = false;
     rightDrive = true;
     //delay(10);
   }
 
-  if(right_sensor_state < 500 && left_sensor_state < 500){
-    Serial.println("going forward");
-    Serial.println(right_sensor_state);
-    Serial.println(left_sensor_state);
-    Serial.println("------------------");
-
+  if(!right_on_line && !left_on_line){
     leftDrive = true;
     rightDrive = true;
     //delay(10);
   }
 
-  if(right_sensor_state > 500 && left_sensor_state > 500){ 
-    Serial.println("stop");
-    Serial.println(right_sensor_state);
-    Serial.println(left_sensor_state);
-    Serial.println("------------------");
-
+  if(right_on_line && left_on_line){ 
     leftDrive = false;
     rightDrive = false;
     //delay(10);
   }
+
+  sendTelemetry(senseLeftOut, senseRightOut);
 }
 
 /**
@@ -85,46 +167,101 @@ void LineSensor::setLineFollowForward() {
  * @author Jack Bergin
  */
 void LineSensor::setLineFollowBackward() {
-    int left_sensor_state = readSensor(true);
-    int right_sensor_state = readSensor(false);
-
-  if(right_sensor_state > 500 && left_sensor_state < 500){
-    Serial.println("turning left");
-    Serial.println(right_sensor_state);
-    Serial.println(left_sensor_state);
-    Serial.println("------------------");
+    update(); // One coherent pair for both decisions
+    bool left_on_line = onLine(true);
+    bool right_on_line = onLine(false);
 
+  if(right_on_line && !left_on_line){
     leftDrive = false;
     rightDrive = true;
     //delay(100);
   }
-  if(right_sensor_state < 500 && left_sensor_state > 500){
-    Serial.println("turning right");
-    Serial.println(right_sensor_state);
-    Serial.println(left_sensor_state);
-    Serial.println("------------------");    
-
+  if(!right_on_line && left_on_line){
     leftDrive = true;
     rightDrive = false;
   }
 
-  if(right_sensor_state > 500 && left_sensor_state > 500){
-    Serial.println("going backward");
-    Serial.println(right_sensor_state);
-    Serial.println(left_sensor_state);
-    Serial.println("------------------");
-
+  if(right_on_line && left_on_line){
     leftDrive = true; // Both need to be in reverse
     rightDrive = true;
   }
 
-  if(right_sensor_state < 500 && left_sensor_state < 500){ 
-    Serial.println("stop");
-    Serial.println(right_sensor_state);
-    Serial.println(left_sensor_state);
-    Serial.println("------------------");    
-
+  if(!right_on_line && !left_on_line){ 
     leftDrive = false;
     rightDrive = false;
   }
-}
\ No newline at end of file
+
+  sendTelemetry(senseLeftOut, senseRightOut);
+}
+
+/**
+ * @return True while both sensors are on crossing tape, debounced
+ */
+bool LineSensor::isAtIntersection() {
+    return atIntersection;
+}
+
+/**
+ * @return Intersections entered since boot. Only ever counts up (and wraps), so
+ *         compare two readings to count the crossings in between.
+ */
+uint16_t LineSensor::getIntersections() {
+    return intersections;
+}
+
+/**
+ * @param fn Called from `sample()` as the robot enters each intersection, with
+ *           the new count
+ */
+void LineSensor::setIntersectionListener(void (*fn)(uint16_t count)) {
+    intersectionListener = fn;
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+/**
+ * @return `reading` scaled from min..max to 0..1, clamped
+ */
+float LineSensor::normalize(int reading, int min, int max) {
+    if (max <= min) return 0;
+    float value = (float)(reading - min) / (max - min);
+    return (value < 0) ? 0 : (value > 1) ? 1 : value;
+}
+
+/**
+ * Copy the newest coherent pair from the ADC sampler
+ */
+void LineSensor::update() {
+    uint16_t values[SENSOR_COUNT];
+    if (!halAdcRead(values)) return;
+    senseLeftOut = values[0];
+    senseRightOut = values[1];
+}
+
+/**
+ * Run one sample of the intersection detector on the normalized readings
+ */
+void LineSensor::detectIntersection(float left, float right) {
+    leftOnTape = leftOnTape ? left > TAPE_OFF : left >= TAPE_ON;
+    rightOnTape = rightOnTape ? right > TAPE_OFF : right >= TAPE_ON;
+
+    if ((leftOnTape && rightOnTape) == atIntersection) {
+        dwell = 0;
+        return;
+    }
+    if (++dwell < INTERSECTION_DWELL) return;
+
+    dwell = 0;
+    atIntersection = !atIntersection;
+    if (atIntersection) {
+        intersections++;
+        if (intersectionListener) intersectionListener(intersections);
+    }
+}
+
+/**
+ * Queue the readings and the resulting drive decision on the telemetry stream
+ */
+void LineSensor::sendTelemetry(int left, int right) {
+    telemetry.send(Telemetry::LINE, left, right, 0, (leftDrive << 1) | rightDrive, 0, 0, 0, 0);
+}
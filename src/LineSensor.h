@@ -1,4 +1,5 @@
 #include <Arduino.h>
+#include "SensorFrame.h"
 
 #pragma once
 
@@ -6,7 +7,18 @@ class LineSensor {
     public:
         void setup();
         void loop();
+        void sample(SensorFrame &frame);
         int readSensor(bool left);
+        void startCalibration();
+        bool finishCalibration();
+        bool isCalibrating();
+        void setRange(bool left, int min, int max);
+        int pullMin(bool left);
+        int pullMax(bool left);
+        bool onLine(bool left);
+        bool isAtIntersection();
+        uint16_t getIntersections();
+        void setIntersectionListener(void (*fn)(uint16_t count));
         void setLineFollowForward();
         void setLineFollowBackward();
 
@@ -14,11 +26,45 @@ class LineSensor {
         bool rightDrive = false;
 
     private:
-        const int leftSensorPin = 20;
-        const int rightSensorPin = 21;
-        const int TABLE_THRESHOLD = 60; // Sensor reading for the reflectance of the lab table 
-        const int LINE_THRESHOLD = 800; // Sensor reading for the reflectance of the line (black tape)
+        void update();
+        float normalize(int reading, int min, int max);
+        void detectIntersection(float left, float right);
+        void sendTelemetry(int left, int right);
 
-        int senseLeftOut;
-        int senseRightOut;
+        static const uint8_t leftSensorPin = 20;
+        static const uint8_t rightSensorPin = 21;
+        const float MIN_CONFIDENCE = 0.2;   // Normalized reading below which neither sensor is on the tape
+        const int MIN_SPAN = 200;           // Smallest believable difference between table and tape readings
+
+        static const uint8_t SENSOR_COUNT = 2;
+        int senseLeftOut = 0;
+        int senseRightOut = 0;
+
+        // Readings over the table (min) and the tape (max); set from Calibration
+        int leftMin = 0;
+        int leftMax = 1023;
+        int rightMin = 0;
+        int rightMax = 1023;
+        int savedLeftMin = 0;       // Restored if a calibration fails
+        int savedLeftMax = 1023;
+        int savedRightMin = 0;
+        int savedRightMax = 1023;
+        bool calibrating = false;
+
+        float offset = 0;
+        float confidence = 0;
+
+        // Intersection detector. Each sensor is on the tape from TAPE_ON until it
+        // drops to TAPE_OFF, normalized; on a straight, centred run both read about
+        // half. The intersection state only changes after INTERSECTION_DWELL
+        // consecutive samples disagree with it.
+        const float TAPE_ON = 0.8;
+        const float TAPE_OFF = 0.6;
+        static const uint8_t INTERSECTION_DWELL = 3;    // Samples (30ms); still catches a 3/4" crossing at 20 in/s
+        bool leftOnTape = false;
+        bool rightOnTape = false;
+        bool atIntersection = false;
+        uint8_t dwell = 0;
+        uint16_t intersections = 0;
+        void (*intersectionListener)(uint16_t count) = 0;
 };
\ No newline at end of file
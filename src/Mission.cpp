@@ -0,0 +1,310 @@
+#include <Arduino.h>
+#include "Mission.h"
+#include "Telemetry.h"
+#include "Calibration.h"
+#include "EStop.h"
+
+// Indexed by Mission::Action; fixed width so the table can live in flash.
+static const char actionNames[Mission::END + 1][22] PROGMEM = {
+    "LIFT", "GRIP", "TURN", "DRIVE_UNTIL_FARTHER", "DRIVE_UNTIL_CLOSER",
+    "DRIVE_TO_INTERSECTION", "WAIT", "CONFIRM", "END"
+};
+
+/**
+ * Print an action's name out of flash
+ */
+static void printAction(uint8_t action) {
+    char name[sizeof(actionNames[0])];
+    strcpy_P(name, actionNames[action]);
+    Serial.print(name);
+}
+
+Mission::Mission(Chassis &chassis, BlueMotor &blueMotor, Servo32U4 &servo)
+    : chassis(chassis), blueMotor(blueMotor), servo(servo) {
+}
+
+/**
+ * Begin executing a step table
+ * @param steps Table in PROGMEM, terminated by `stepEnd()`
+ */
+void Mission::start(const MissionStep *steps) {
+    table = steps;
+    groupStart = 0;
+    groupLength = 0;
+    complete = false;
+    startGroup();
+}
+
+/**
+ * Advance the running steps. Call at a fixed rate (the scheduler runs it at 100Hz)
+ * with the tick's sensor frame; nothing in here blocks. Holds while the E-stop is
+ * latched.
+ */
+void Mission::loop(const SensorFrame &frame) {
+    intersections = frame.intersections;
+    if (!table || complete || estop.isTripped()) return;
+
+    bool groupDone = true;
+    for (uint8_t i = 0; i < groupLength; i++) {
+        if (done[i]) continue;
+        if (runStep(i, frame)) {
+            done[i] = true;
+            Serial.print(F("  || Step "));
+            Serial.print(groupStart + i);
+            Serial.print(' ');
+            printAction(active[i].action);
+            Serial.print(F(" done, ms: "));
+            Serial.println(millis() - stepStart[i]);
+        } else {
+            groupDone = false;
+        }
+    }
+
+    if (groupDone) {
+        groupStart += groupLength;
+        startGroup();
+    }
+}
+
+/**
+ * Complete the CONFIRM step that is waiting, if any
+ */
+void Mission::confirm() {
+    confirmed = true;
+}
+
+/**
+ * Pick up after an E-stop pause: step timers do not count the pause, so a WAIT
+ * step waits its full time and a stale range is not judged lost because of it
+ * @param pausedMillis How long the stop was latched
+ */
+void Mission::resume(unsigned long pausedMillis) {
+    for (uint8_t i = 0; i < groupLength; i++) stepStart[i] += pausedMillis;
+    rangeStaleSince += pausedMillis;
+}
+
+/**
+ * @param autoConfirm True to let CONFIRM steps time out instead of waiting for `confirm()`
+ */
+void Mission::setAutoConfirm(bool autoConfirm) {
+    this->autoConfirm = autoConfirm;
+}
+
+bool Mission::isStarted() {
+    return table != 0;
+}
+
+bool Mission::isComplete() {
+    return complete;
+}
+
+bool Mission::isAwaitingConfirm() {
+    for (uint8_t i = 0; i < groupLength; i++) {
+        if (!done[i] && active[i].action == CONFIRM && !autoConfirm) return true;
+    }
+    return false;
+}
+
+/**
+ * @return Index of the first step of the group that is running
+ */
+uint8_t Mission::getStep() {
+    return groupStart;
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+/**
+ * Load the steps linked by WITH_NEXT from `groupStart` out of flash and start them
+ */
+void Mission::startGroup() {
+    groupLength = 0;
+    bool linked = true;
+    while (linked && groupLength < MAX_CONCURRENT) {
+        memcpy_P(&active[groupLength], &table[groupStart + groupLength], sizeof(MissionStep));
+        linked = (active[groupLength].flags & WITH_NEXT) && active[groupLength].action != END;
+        groupLength++;
+    }
+
+    telemetry.setStep(groupStart);
+    for (uint8_t i = 0; i < groupLength; i++) startStep(i);
+}
+
+void Mission::startStep(uint8_t slot) {
+    const MissionStep &s = active[slot];
+    done[slot] = false;
+    stepStart[slot] = millis();
+
+    switch (s.action) {
+        case LIFT:
+        if (paramOf(s) == Calibration::NONE) blueMotor.startMoveTo(s.a);
+        else blueMotor.startMoveTo((calibration.get(paramOf(s)) + s.a / 100.0)
+            * calibration.get(Calibration::GEAR_RATIO_LIFTER));
+        break;
+
+        case GRIP:
+        servo.Write(paramOf(s) == Calibration::NONE ? s.a : (int)calibration.get(paramOf(s)));
+        break;
+
+        case TURN:
+        chassis.startTurn(s.a);
+        break;
+
+        case DRIVE_UNTIL_FARTHER:
+        case DRIVE_UNTIL_CLOSER:
+        rangeStale = false;
+        driveFrom = chassis.getOdometry().getPose();
+        predictionCount = 0;
+        nextPrediction = 0;
+        predictionMillis = stepStart[slot];
+        driveLimit = -1;
+        chassis.setVelocities(s.a / 100.0, s.b / 100.0);
+        break;
+
+        case DRIVE_TO_INTERSECTION:
+        intersectionTarget = intersections + s.c;
+        chassis.startLineFollow(s.a / 100.0);
+        break;
+
+        case CONFIRM:
+        confirmed = false;
+        Serial.println(F("Awaiting user confirmation"));
+        break;
+
+        case END:
+        complete = true;
+        chassis.drive(0);
+        Serial.println(F("Autonomous sequence complete."));
+        printPose();
+        break;
+    }
+}
+
+/**
+ * Print where odometry thinks the robot ended up, relative to where it started
+ */
+void Mission::printPose() {
+    Pose pose = chassis.getOdometry().getPose();
+    Serial.print(F("  || Pose x: "));
+    Serial.print(pose.x);
+    Serial.print(F(" y: "));
+    Serial.print(pose.y);
+    Serial.print(F(" heading: "));
+    Serial.println(chassis.getOdometry().getHeadingDegrees());
+}
+
+uint8_t Mission::paramOf(const MissionStep &s) {
+    return s.flags >> PARAM_SHIFT;
+}
+
+/**
+ * @return Range (inches) that ends a DRIVE_UNTIL_* step
+ */
+float Mission::rangeTarget(const MissionStep &s) {
+    float target = s.c / 100.0;
+    if (paramOf(s) != Calibration::NONE) target += calibration.get(paramOf(s));
+    return target;
+}
+
+/**
+ * Stop a DRIVE_UNTIL_* step while the range is stale, as chassisTask does for
+ * the ultrasonic PID, so the robot cannot drive past its target blind. A range
+ * that stays stale for RANGE_LOST_MS trips the E-stop; PlayPause resumes the drive.
+ * @return False: the step is not finished
+ */
+bool Mission::holdForRange() {
+    chassis.drive(0);
+    if (!rangeStale) {
+        rangeStale = true;
+        rangeStaleSince = millis();
+    } else if (millis() - rangeStaleSince >= RANGE_LOST_MS) {
+        Serial.println(F("  || Range lost during a drive"));
+        rangeStale = false;
+        estop.trip();
+    }
+    return false;
+}
+
+/**
+ * Bound a DRIVE_UNTIL_* step by odometry. Every echo that came back after the
+ * step started predicts how far the wheels travel in all. Each PREDICTIONS of them
+ * in a row give one bound, their median, and the lowest bound so far plus
+ * RANGE_SLACK_IN is as far as the step may go. A single stray reading is outvoted,
+ * so it cannot end the step early, yet a later run of long readings (stray
+ * reflections) cannot carry the robot on past a target the good ones agreed on.
+ * @param remaining Inches the current reading says are left
+ * @return True once the wheels have gone past the limit
+ */
+bool Mission::pastRange(float remaining, const SensorFrame &frame) {
+    Pose pose = chassis.getOdometry().getPose();
+    float dx = pose.x - driveFrom.x, dy = pose.y - driveFrom.y;
+    float travelled = sqrt(dx * dx + dy * dy);
+    if ((long)(frame.rangeMillis - predictionMillis) > 0) { // A new echo, and not one from before the step
+        predictionMillis = frame.rangeMillis;
+        predictions[nextPrediction] = travelled + remaining;
+        nextPrediction = (nextPrediction + 1) % PREDICTIONS;
+        if (predictionCount < PREDICTIONS) predictionCount++;
+        if (predictionCount == PREDICTIONS) {
+            float sorted[PREDICTIONS];
+            for (uint8_t i = 0; i < PREDICTIONS; i++) {
+                uint8_t j = i;
+                for (; j > 0 && sorted[j - 1] > predictions[i]; j--) sorted[j] = sorted[j - 1]; // Insertion sort
+                sorted[j] = predictions[i];
+            }
+            float median = sorted[PREDICTIONS / 2];
+            if (driveLimit < 0 || median < driveLimit) driveLimit = median;
+        }
+    }
+    if (driveLimit < 0 || travelled <= driveLimit + RANGE_SLACK_IN) return false;
+    Serial.println(F("  || Range disagrees with odometry, stopping"));
+    return true;
+}
+
+/**
+ * @return True once the step in `slot` has finished
+ */
+bool Mission::runStep(uint8_t slot, const SensorFrame &frame) {
+    const MissionStep &s = active[slot];
+
+    switch (s.action) {
+        case LIFT:
+        return blueMotor.pullOnTarget(frame);
+
+        case TURN:
+        return chassis.turnComplete();
+
+        case DRIVE_UNTIL_FARTHER:
+        case DRIVE_UNTIL_CLOSER: {
+            if (!frame.rangeFresh) return holdForRange();
+            rangeStale = false;
+            float target = rangeTarget(s);
+            float remaining = (s.action == DRIVE_UNTIL_FARTHER) ? target - frame.range : frame.range - target;
+            if (remaining > 0 && !pastRange(remaining, frame)) {
+                chassis.setVelocities(s.a / 100.0, s.b / 100.0); // Re-applied so a pause does not end the drive
+                return false;
+            }
+            chassis.drive(0);
+            return true;
+        }
+
+        case DRIVE_TO_INTERSECTION:
+        if ((int16_t)(frame.intersections - intersectionTarget) < 0) { // Wrap-safe
+            chassis.startLineFollow(s.a / 100.0); // Re-applied so a pause does not end the drive
+            return false;
+        }
+        chassis.drive(0);
+        return true;
+
+        case WAIT:
+        return millis() - stepStart[slot] >= (uint16_t)s.a;
+
+        case CONFIRM:
+        return autoConfirm ? millis() - stepStart[slot] >= (uint16_t)s.a : confirmed;
+
+        case END:
+        return false;
+
+        default:
+        return true;
+    }
+}
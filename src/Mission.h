@@ -0,0 +1,175 @@
+#include <Arduino.h>
+#include "Chassis.h"
+#include "BlueMotor.h"
+#include "SensorFrame.h"
+#include "servo32u4.h"
+#include "Calibration.h"
+
+#pragma once
+
+/**
+ * One step of a mission table. Tables live in flash (PROGMEM) and are built
+ * with the `step*()` helpers below, e.g.
+ *
+ *   const MissionStep ROOF[] PROGMEM = {
+ *       together(stepLift(-462)),          // Lift and back up at the same time...
+ *       stepDriveUntilFarther(-5.0, -5.0, 10.45),
+ *       stepTurn(-90),                     // ...then turn once both are done
+ *       stepEnd()
+ *   };
+ *
+ * Steps built with a Calibration::Param (`stepLiftTo()`, `stepGripTo()`, ...)
+ * read that value when they start, so a `cal` change over Serial applies to
+ * the next run without a rebuild.
+ */
+struct MissionStep {
+    uint8_t action;
+    uint8_t flags;
+    int16_t a;
+    int16_t b;
+    int16_t c;
+};
+
+class Mission {
+    public:
+        enum Action {
+            LIFT,               // a = lifter setpoint, motor degrees; calibrated: arm degrees offset, hundredths
+            GRIP,               // a = servo position, microseconds; calibrated: unused
+            TURN,               // a = degrees, positive is clockwise
+            DRIVE_UNTIL_FARTHER,// a, b = left/right speed in hundredths of an in/s; c = range (or offset) in hundredths of an inch
+            DRIVE_UNTIL_CLOSER, // Same, stopping once the range drops to c
+            DRIVE_TO_INTERSECTION, // a = speed in hundredths of an in/s, following the tape; c = crossings (1 stops at the next)
+            WAIT,               // a = milliseconds
+            CONFIRM,            // Wait for `confirm()`; with auto-confirm, wait a milliseconds instead
+            END
+        };
+
+        // Step flag: start the next step at the same time. A run of linked steps
+        // finishes when all of them have.
+        static const uint8_t WITH_NEXT = 0x01;
+        // The upper nibble of the flags holds the Calibration::Param the step's
+        // target is measured from, or NONE for a literal target.
+        static const uint8_t PARAM_SHIFT = 4;
+
+        Mission(Chassis &chassis, BlueMotor &blueMotor, Servo32U4 &servo);
+        void start(const MissionStep *steps);
+        void loop(const SensorFrame &frame);
+        void confirm();
+        void resume(unsigned long pausedMillis);
+        void setAutoConfirm(bool autoConfirm);
+        bool isStarted();
+        bool isComplete();
+        bool isAwaitingConfirm();
+        uint8_t getStep();
+
+    private:
+        static const uint8_t MAX_CONCURRENT = 4;
+        static const unsigned long RANGE_LOST_MS = 2000;    // Stale range that trips the E-stop mid-drive
+        static constexpr float RANGE_SLACK_IN = 1.5;        // Travel allowed past the end the range predicted
+        static const uint8_t PREDICTIONS = 3;               // Readings in a row whose median is one bound on the drive
+
+        void startGroup();
+        void startStep(uint8_t slot);
+        bool runStep(uint8_t slot, const SensorFrame &frame);
+        void printPose();
+        uint8_t paramOf(const MissionStep &s);
+        float rangeTarget(const MissionStep &s);
+        bool holdForRange();
+        bool pastRange(float remaining, const SensorFrame &frame);
+
+        Chassis &chassis;
+        BlueMotor &blueMotor;
+        Servo32U4 &servo;
+
+        const MissionStep *table = 0;
+        uint8_t groupStart = 0;
+        uint8_t groupLength = 0;
+        MissionStep active[MAX_CONCURRENT];
+        bool done[MAX_CONCURRENT];
+        unsigned long stepStart[MAX_CONCURRENT];
+        uint16_t intersections = 0;         // Count from the latest frame
+        uint16_t intersectionTarget = 0;    // Count that ends the running DRIVE_TO_INTERSECTION
+        bool rangeStale = false;            // A DRIVE_UNTIL_* step is holding for the rangefinder
+        unsigned long rangeStaleSince = 0;  // millis()
+        Pose driveFrom;                     // Odometry when the DRIVE_UNTIL_* step started
+        float predictions[PREDICTIONS];     // Wheel travel, inches, at which each recent reading says the drive ends
+        uint8_t predictionCount = 0;
+        uint8_t nextPrediction = 0;
+        unsigned long predictionMillis = 0; // Echo time of the newest prediction
+        float driveLimit = -1;              // Lowest median of PREDICTIONS in a row so far; -1 until known
+        bool autoConfirm = false;
+        bool confirmed = false;
+        bool complete = false;
+};
+
+constexpr MissionStep together(MissionStep s) {
+    return MissionStep{s.action, (uint8_t)(s.flags | Mission::WITH_NEXT), s.a, s.b, s.c};
+}
+
+constexpr int16_t hundredths(float value) {
+    return (int16_t)(value * 100 + (value >= 0 ? 0.5 : -0.5));
+}
+
+constexpr MissionStep stepLift(float motorDegrees) {
+    return MissionStep{Mission::LIFT, 0, (int16_t)motorDegrees, 0, 0};
+}
+
+/**
+ * Lift to a calibrated arm height (Calibration::LIFTER_*) plus `armOffset` arm
+ * degrees, scaled by the calibrated gear ratio
+ */
+constexpr MissionStep stepLiftTo(uint8_t param, float armOffset) {
+    return MissionStep{Mission::LIFT, (uint8_t)(param << Mission::PARAM_SHIFT), hundredths(armOffset), 0, 0};
+}
+
+constexpr MissionStep stepGrip(int microseconds) {
+    return MissionStep{Mission::GRIP, 0, (int16_t)microseconds, 0, 0};
+}
+
+constexpr MissionStep stepGripTo(uint8_t param) {
+    return MissionStep{Mission::GRIP, (uint8_t)(param << Mission::PARAM_SHIFT), 0, 0, 0};
+}
+
+constexpr MissionStep stepTurn(int degrees) {
+    return MissionStep{Mission::TURN, 0, (int16_t)degrees, 0, 0};
+}
+
+constexpr MissionStep stepDriveUntilFarther(float left, float right, float inches) {
+    return MissionStep{Mission::DRIVE_UNTIL_FARTHER, 0, hundredths(left), hundredths(right), hundredths(inches)};
+}
+
+constexpr MissionStep stepDriveUntilCloser(float left, float right, float inches) {
+    return MissionStep{Mission::DRIVE_UNTIL_CLOSER, 0, hundredths(left), hundredths(right), hundredths(inches)};
+}
+
+/**
+ * Drive until the range reaches a calibrated distance (Calibration::DIST_*) plus `offset` inches
+ */
+constexpr MissionStep stepDriveUntilFarther(float left, float right, uint8_t param, float offset) {
+    return MissionStep{Mission::DRIVE_UNTIL_FARTHER, (uint8_t)(param << Mission::PARAM_SHIFT),
+        hundredths(left), hundredths(right), hundredths(offset)};
+}
+
+constexpr MissionStep stepDriveUntilCloser(float left, float right, uint8_t param, float offset) {
+    return MissionStep{Mission::DRIVE_UNTIL_CLOSER, (uint8_t)(param << Mission::PARAM_SHIFT),
+        hundredths(left), hundredths(right), hundredths(offset)};
+}
+
+/**
+ * Follow the tape forward until the sensors have entered `crossings` intersections
+ */
+constexpr MissionStep stepFollowLineTo(float speed, int crossings) {
+    return MissionStep{Mission::DRIVE_TO_INTERSECTION, 0, hundredths(speed), 0, (int16_t)crossings};
+}
+
+constexpr MissionStep stepWait(unsigned int ms) {
+    return MissionStep{Mission::WAIT, 0, (int16_t)ms, 0, 0};
+}
+
+constexpr MissionStep stepConfirm(unsigned int autoMs) {
+    return MissionStep{Mission::CONFIRM, 0, (int16_t)autoMs, 0, 0};
+}
+
+constexpr MissionStep stepEnd() {
+    return MissionStep{Mission::END, 0, 0, 0, 0};
+}
@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include "MotionProfile.h"
+
+/**
+ * @param maxVelocity Cruise speed, units per second
+ * @param maxAcceleration Acceleration and deceleration, units per second squared
+ */
+void MotionProfile::setLimits(float maxVelocity, float maxAcceleration) {
+    this->maxVelocity = maxVelocity;
+    this->maxAcceleration = maxAcceleration;
+}
+
+/**
+ * Plan a move from rest at `from` to rest at `to`, starting now
+ */
+void MotionProfile::start(float from, float to) {
+    origin = from;
+    target = to;
+    direction = (to >= from) ? 1.0 : -1.0;
+    distance = abs(to - from);
+
+    accelTime = maxVelocity / maxAcceleration;
+    float cruiseTime;
+    if (distance < maxVelocity * accelTime) { // Triangular: never reaches maxVelocity
+        accelTime = sqrt(distance / maxAcceleration);
+        cruiseTime = 0;
+    } else {
+        cruiseTime = (distance - maxVelocity * accelTime) / maxVelocity;
+    }
+    peakVelocity = maxAcceleration * accelTime;
+    totalTime = 2 * accelTime + cruiseTime;
+    startMicros = micros();
+}
+
+/**
+ * @return Where the move should be right now
+ */
+float MotionProfile::getSetpoint() {
+    float t = elapsed();
+    float travelled;
+
+    if (t >= totalTime) {
+        travelled = distance;
+    } else if (t < accelTime) {
+        travelled = 0.5 * maxAcceleration * t * t;
+    } else if (t < totalTime - accelTime) {
+        travelled = 0.5 * peakVelocity * accelTime + peakVelocity * (t - accelTime);
+    } else {
+        float remaining = totalTime - t;
+        travelled = distance - 0.5 * maxAcceleration * remaining * remaining;
+    }
+    return origin + direction * travelled;
+}
+
+/**
+ * @return How fast the setpoint is moving right now, units per second
+ */
+float MotionProfile::getVelocity() {
+    float t = elapsed();
+    float speed;
+
+    if (t >= totalTime) {
+        speed = 0;
+    } else if (t < accelTime) {
+        speed = maxAcceleration * t;
+    } else if (t < totalTime - accelTime) {
+        speed = peakVelocity;
+    } else {
+        speed = maxAcceleration * (totalTime - t);
+    }
+    return direction * speed;
+}
+
+float MotionProfile::getTarget() {
+    return target;
+}
+
+/**
+ * @return True once the setpoint has reached the target
+ */
+bool MotionProfile::isComplete() {
+    return elapsed() >= totalTime;
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+float MotionProfile::elapsed() {
+    return (micros() - startMicros) / 1.0e6;
+}
@@ -0,0 +1,33 @@
+#include <Arduino.h>
+
+#pragma once
+
+/**
+ * Trapezoidal motion profile: accelerate at a fixed rate up to a velocity limit,
+ * cruise, then decelerate into the target. Short moves that never reach the
+ * velocity limit become triangular. Time runs from `start()` on micros().
+ */
+class MotionProfile {
+    public:
+        void setLimits(float maxVelocity, float maxAcceleration);
+        void start(float from, float to);
+        float getSetpoint();
+        float getVelocity();
+        float getTarget();
+        bool isComplete();
+
+    private:
+        float elapsed();
+
+        float maxVelocity = 1.0;
+        float maxAcceleration = 1.0;
+
+        float origin = 0.0;
+        float target = 0.0;
+        float direction = 1.0;
+        float distance = 0.0;
+        float peakVelocity = 0.0;
+        float accelTime = 0.0;      // Seconds spent accelerating, and again decelerating
+        float totalTime = 0.0;
+        unsigned long startMicros = 0;
+};
@@ -0,0 +1,97 @@
+#include <Arduino.h>
+#include "Odometry.h"
+
+/**
+ * @param wheelDiameter Wheel diameter, inches
+ * @param wheelTrack Distance between the wheels, inches
+ * @param cpr Encoder counts per wheel revolution
+ */
+Odometry::Odometry(float wheelDiameter, float wheelTrack, int cpr)
+    : inchesPerCount(PI * wheelDiameter / cpr), wheelTrack(wheelTrack) {
+}
+
+/**
+ * Start counting from wherever the encoders are now
+ */
+void Odometry::setup() {
+    lastLeft = encoders.getCountsLeft();
+    lastRight = encoders.getCountsRight();
+    lastMicros = micros();
+}
+
+/**
+ * Integrate the wheel travel since the last call into the pose
+ */
+void Odometry::update() {
+    int16_t left = encoders.getCountsLeft();
+    int16_t right = encoders.getCountsRight();
+    unsigned long now = micros();
+
+    int16_t dLeft = left - lastLeft;    // Wraps correctly across the 16-bit rollover
+    int16_t dRight = right - lastRight;
+    unsigned long dt = now - lastMicros;
+    lastLeft = left;
+    lastRight = right;
+    lastMicros = now;
+
+    leftCounts += dLeft;
+    rightCounts += dRight;
+    if (dt > 0) {
+        leftVelocity = dLeft * inchesPerCount * 1.0e6 / dt;
+        rightVelocity = dRight * inchesPerCount * 1.0e6 / dt;
+    }
+
+    // Advance along the mean heading of the step
+    float forward = (dLeft + dRight) * 0.5 * inchesPerCount;
+    float turned = (dRight - dLeft) * inchesPerCount / wheelTrack;
+    float heading = pose.heading + turned * 0.5;
+    pose.x += forward * cos(heading);
+    pose.y += forward * sin(heading);
+    pose.heading += turned;
+}
+
+/**
+ * Make the current position the origin, facing along x. The wheel counts keep running.
+ */
+void Odometry::reset() {
+    pose = {0.0, 0.0, 0.0};
+}
+
+Pose Odometry::getPose() {
+    return pose;
+}
+
+/**
+ * @return Heading in degrees, counter-clockwise positive and not wrapped
+ */
+float Odometry::getHeadingDegrees() {
+    return pose.heading * (180.0 / PI);
+}
+
+/**
+ * @return Left wheel speed in inches per second, positive forward
+ */
+float Odometry::getLeftVelocity() {
+    return leftVelocity;
+}
+
+/**
+ * @return Right wheel speed in inches per second, positive forward
+ */
+float Odometry::getRightVelocity() {
+    return rightVelocity;
+}
+
+/**
+ * @return Left wheel counts since setup(); compare two readings to measure travel
+ */
+long Odometry::getLeftCounts() {
+    return leftCounts;
+}
+
+/**
+ * @return Right wheel counts since setup(); compare two readings to measure travel
+ */
+long Odometry::getRightCounts() {
+    return rightCounts;
+}
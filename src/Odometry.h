@@ -0,0 +1,49 @@
+#include <Arduino.h>
+#include <Romi32U4.h>
+
+#pragma once
+
+/**
+ * Robot pose on the field. x is forward and y is to the left of where the robot
+ * stood at `Odometry::reset()`; heading is in radians, counter-clockwise positive.
+ */
+struct Pose {
+    float x;
+    float y;
+    float heading;
+};
+
+/**
+ * Differential-drive dead reckoning. `update()` samples both wheel encoders
+ * without resetting them and integrates the pose, so every motion primitive can
+ * measure its own progress against the same estimate. Call it at a fixed rate
+ * (the scheduler runs it at 100Hz); the 16-bit hardware counts may wrap safely
+ * as long as fewer than 32768 counts pass between calls.
+ */
+class Odometry {
+    public:
+        Odometry(float wheelDiameter, float wheelTrack, int cpr);
+        void setup();
+        void update();
+        void reset();
+        Pose getPose();
+        float getHeadingDegrees();
+        float getLeftVelocity();
+        float getRightVelocity();
+        long getLeftCounts();
+        long getRightCounts();
+
+    private:
+        Romi32U4Encoders encoders;
+        const float inchesPerCount;
+        const float wheelTrack;
+
+        Pose pose = {0.0, 0.0, 0.0};
+        int16_t lastLeft = 0;       // Raw hardware counts at the previous update
+        int16_t lastRight = 0;
+        long leftCounts = 0;        // Counts since setup(), widened past 16 bits
+        long rightCounts = 0;
+        float leftVelocity = 0.0;   // Inches per second over the last update
+        float rightVelocity = 0.0;
+        unsigned long lastMicros = 0;
+};
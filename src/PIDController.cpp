@@ -2,6 +2,70 @@
 #include <Romi32U4.h>
 #include "PIDController.h"
 
+static const long TERM_LIMIT = 0x1FFFFFFFL; // Each Q.14 term stays below 2^29 so P + I + D cannot overflow
+static const long DELTA_LIMIT = 0x1FFFFFL;  // Q.4 values this small can be scaled by a Q.8 step length
+static const long SAMPLE_TICKS = PIDController::SAMPLE_MICROS / HAL_TICK_MICROS;
+static const uint8_t RECIPROCAL_TICKS = 128;    // Longest step plus filter, in ticks, that can be divided by
+static const long MAX_FILTER_MICROS = (RECIPROCAL_TICKS - 2) * HAL_TICK_MICROS - 4 * PIDController::SAMPLE_MICROS;
+
+#define RECIPROCAL(n) (uint16_t)((n) > 1 ? (65536L + (n) / 2) / ((n) > 1 ? (n) : 1) : 0xFFFF)
+#define RECIPROCAL4(n) RECIPROCAL(n), RECIPROCAL(n + 1), RECIPROCAL(n + 2), RECIPROCAL(n + 3)
+#define RECIPROCAL16(n) RECIPROCAL4(n), RECIPROCAL4(n + 4), RECIPROCAL4(n + 8), RECIPROCAL4(n + 12)
+
+/**
+ * 2^16 / n for n = 0..RECIPROCAL_TICKS-1, rounded (n = 0 and 1 saturate), so the
+ * fixed-point path divides by a length of time with a multiply and a shift.
+ * Worked out by the compiler.
+ */
+static const uint16_t reciprocals[RECIPROCAL_TICKS] PROGMEM = {
+    RECIPROCAL16(0), RECIPROCAL16(16), RECIPROCAL16(32), RECIPROCAL16(48),
+    RECIPROCAL16(64), RECIPROCAL16(80), RECIPROCAL16(96), RECIPROCAL16(112)
+};
+
+/**
+ * Divide by a length of time given in microseconds, 2..RECIPROCAL_TICKS-1 ticks
+ * long. The reciprocal is interpolated between the whole ticks either side.
+ * @return `value * 2^fracBits / (micros / HAL_TICK_MICROS)`, rounded down
+ */
+static long divideByMicros(long value, unsigned long micros, int fracBits) {
+    uint8_t ticks = micros / HAL_TICK_MICROS;
+    long below = pgm_read_word(&reciprocals[ticks]);
+    long above = pgm_read_word(&reciprocals[ticks + 1]);
+    long reciprocal = below - (below - above) * (long)(micros % HAL_TICK_MICROS) / HAL_TICK_MICROS;
+    return (value * reciprocal) >> (16 - fracBits);
+}
+
+/**
+ * Convert to a signed fixed-point value, rounding to nearest
+ */
+static long toFixed(float value, int fracBits) {
+    float scaled = value * (float)(1L << fracBits);
+    return (long)(scaled + (scaled >= 0 ? 0.5 : -0.5));
+}
+
+static long clampLong(long value, long limit) {
+    if (value > limit) return limit;
+    if (value < -limit) return -limit;
+    return value;
+}
+
+/**
+ * Back-calculation anti-windup: take the amount the output went past its limit
+ * back out of the integral, but never past zero, so the integral only gives up
+ * what it contributed to the saturation
+ */
+static float unwind(float integral, float excess) {
+    if (excess > 0 && integral > 0) return (excess < integral) ? integral - excess : 0;
+    if (excess < 0 && integral < 0) return (excess > integral) ? integral - excess : 0;
+    return integral;
+}
+
+static long unwindLong(long integral, long excess) {
+    if (excess > 0 && integral > 0) return (excess < integral) ? integral - excess : 0;
+    if (excess < 0 && integral < 0) return (excess > integral) ? integral - excess : 0;
+    return integral;
+}
+
 PIDController::PIDController() {
     setPID(0, 0, 0);
 }
@@ -10,36 +74,135 @@ PIDController::PIDController(float p, float i, float d) {
     setPID(p, i, d);
 }
 
+/**
+ * @param fixed True to run this instance on the integer (Q-format) path
+ */
+PIDController::PIDController(float p, float i, float d, bool fixed) {
+    fixedPoint = fixed;
+    setPID(p, i, d);
+}
+
 void PIDController::setPID(float p, float i, float d) {
-    errorSum = 0;
-    previousError = 0;
+    reset();
     Kp = p;
     Ki = i;
     Kd = d;
     setpoint = 0;
+    updateFixedPoint();
+}
+
+/**
+ * Change the gains of a running controller. Unlike `setPID()`, the setpoint,
+ * the integral and the derivative history carry on: the integral and derivative
+ * are kept already multiplied by their gains, so the output does not jump.
+ */
+void PIDController::setGains(float p, float i, float d) {
+    Kp = p;
+    Ki = i;
+    Kd = d;
+    updateFixedGains();
+}
+
+/**
+ * Select float or fixed-point math for this instance. Fixed point avoids the
+ * 32U4's software float for everything but the input conversion, at the cost
+ * of 1/16 input resolution and 1/1024 gain resolution.
+ * @param fixed True for fixed point
+ */
+void PIDController::setFixedPoint(bool fixed) {
+    fixedPoint = fixed;
+    updateFixedPoint();
+}
+
+bool PIDController::isFixedPoint() {
+    return fixedPoint;
 }
 
 void PIDController::setSetpoint(float target) {
     setpoint = target;
+    setpointQ = toFixed(target, INPUT_FRAC_BITS);
 }
 
 void PIDController::setTolerance(float t) {
     tolerance = t;
+    toleranceQ = toFixed(t, INPUT_FRAC_BITS);
+}
+
+/**
+ * Saturate the output at +/- `limit`, unwinding the integral by whatever the
+ * unlimited output would have exceeded it by
+ * @param limit Largest output magnitude, or 0 for none
+ */
+void PIDController::setOutputLimit(float limit) {
+    outputLimit = limit;
+    outputLimitQ = toFixed(limit, EFFORT_FRAC_BITS);
+}
+
+/**
+ * @param limit Largest magnitude of the integral term (output units), or 0 for none
+ */
+void PIDController::setIntegralLimit(float limit) {
+    integralLimit = limit;
+    integralLimitQ = toFixed(limit, EFFORT_FRAC_BITS);
+}
+
+/**
+ * Low-pass the derivative term with a first-order filter. The fixed-point path
+ * caps the time constant at MAX_FILTER_MICROS (88ms).
+ * @param seconds Time constant, or 0 for an unfiltered derivative
+ */
+void PIDController::setDerivativeFilter(float seconds) {
+    filterMicros = seconds * 1.0e6;
+}
+
+/**
+ * Clear the integral and derivative history, e.g. at the start of a new move
+ */
+void PIDController::reset() {
+    iTerm = 0;
+    dTerm = 0;
+    iTermQ = 0;
+    dTermQ = 0;
+    primed = false;
 }
 
+/**
+ * Run one step of the controller. Meant to be called once per SAMPLE_MICROS,
+ * but measures the actual time since the last call. A fixed-point instance runs
+ * `calculateEffortFixed()` and converts its result.
+ * @param inputData Measurement
+ * @return Output
+ */
 float PIDController::calculateEffort(float inputData) {
-    int effort;
+    if (fixedPoint) return calculateEffortFixed(inputData) * (1.0 / (1L << EFFORT_FRAC_BITS));
+
+    unsigned long dt = stepMicros();
+    float steps = (float)dt / SAMPLE_MICROS;
     float error = inputData - setpoint;
-    float delta = previousError - error;
 
-    previousError = error;
-    errorSum += error;
-    effort = error * Kp + errorSum * Ki + delta * Kd;
+    if (primed) {
+        float rate = (inputData - previousInput) / steps;
+        dTerm += (float)dt / (filterMicros + dt) * (rate * Kd - dTerm);
+    }
+    previousInput = inputData;
+    primed = true;
+
+    iTerm += error * Ki * steps;
+    if (integralLimit > 0) iTerm = constrain(iTerm, -integralLimit, integralLimit);
+
+    float effort = error * Kp + iTerm + dTerm;
+    if (outputLimit > 0) {
+        float limited = constrain(effort, -outputLimit, outputLimit);
+        iTerm = unwind(iTerm, effort - limited);
+        effort = limited;
+    }
 
     return effort;
 }
 
 bool PIDController::onTarget(float inputData) {
+    if (fixedPoint) return labs(toFixed(inputData, INPUT_FRAC_BITS) - setpointQ) <= toleranceQ;
+
     float error;
     noInterrupts();
     error = inputData - setpoint;
@@ -74,4 +237,86 @@ float PIDController::getGainValue(int index) {
 
 float PIDController::getSetpoint() {
     return setpoint;
-}
\ No newline at end of file
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+/**
+ * @return Microseconds since the previous step, SAMPLE_MICROS for the first step
+ *         after a reset, and never outside MIN_STEP_MICROS..MAX_STEP_MICROS
+ */
+unsigned long PIDController::stepMicros() {
+    unsigned long now = micros();
+    unsigned long dt = primed ? now - lastMicros : SAMPLE_MICROS;
+    lastMicros = now;
+    if (dt < (unsigned long)MIN_STEP_MICROS) return MIN_STEP_MICROS;
+    if (dt > (unsigned long)MAX_STEP_MICROS) return MAX_STEP_MICROS;
+    return dt;
+}
+
+/**
+ * Integer version of `calculateEffort()`, for any instance. Errors are clamped per
+ * term so every product fits in 32 bits, which keeps the multiplies on avr-gcc's
+ * 32x32->32 path. The step is the measured one, as on the float path, and is
+ * divided by through the reciprocal table.
+ * @param inputData Measurement
+ * @return Output in Q.EFFORT_FRAC_BITS; shift right by EFFORT_FRAC_BITS for the effort
+ */
+long PIDController::calculateEffortFixed(float inputData) {
+    unsigned long dt = stepMicros();
+
+    long input = toFixed(inputData, INPUT_FRAC_BITS);
+    long error = input - setpointQ;
+
+    if (primed) {
+        long rateScale = divideByMicros(SAMPLE_TICKS, dt, STEP_FRAC_BITS); // Samples per step
+        long rate = (clampLong(input - previousInputQ, DELTA_LIMIT) * rateScale) >> STEP_FRAC_BITS;
+        long raw = clampLong(rate, errorLimitD) * KdQ;
+        if (filterMicros == 0) dTermQ = raw;
+        else {
+            long filter = (filterMicros < MAX_FILTER_MICROS) ? filterMicros : MAX_FILTER_MICROS;
+            long alpha = divideByMicros(dt, filter + dt, STEP_FRAC_BITS) / HAL_TICK_MICROS; // Weight of this step
+            dTermQ += ((raw - dTermQ) >> STEP_FRAC_BITS) * alpha;
+        }
+    }
+    previousInputQ = input;
+    primed = true;
+
+    long steps = divideByMicros(dt, SAMPLE_MICROS, STEP_FRAC_BITS) / HAL_TICK_MICROS;
+    long scaledError = (clampLong(error, DELTA_LIMIT) * steps) >> STEP_FRAC_BITS;
+    iTermQ = clampLong(iTermQ + clampLong(scaledError, errorLimitI) * KiQ,
+                       (integralLimitQ > 0 && integralLimitQ < TERM_LIMIT) ? integralLimitQ : TERM_LIMIT);
+    long effort = clampLong(error, errorLimitP) * KpQ + iTermQ + dTermQ;
+    if (outputLimitQ > 0) {
+        long limited = clampLong(effort, outputLimitQ);
+        iTermQ = unwindLong(iTermQ, effort - limited);
+        effort = limited;
+    }
+
+    return effort;
+}
+
+/**
+ * Recompute the Q-format copies of the gains, setpoint and tolerance and reset
+ * the fixed-point state.
+ */
+void PIDController::updateFixedPoint() {
+    updateFixedGains();
+    setpointQ = toFixed(setpoint, INPUT_FRAC_BITS);
+    toleranceQ = toFixed(tolerance, INPUT_FRAC_BITS);
+    outputLimitQ = toFixed(outputLimit, EFFORT_FRAC_BITS);
+    integralLimitQ = toFixed(integralLimit, EFFORT_FRAC_BITS);
+    reset();
+}
+
+/**
+ * Recompute the Q-format copies of the gains and the error clamps that go with them
+ */
+void PIDController::updateFixedGains() {
+    KpQ = toFixed(Kp, GAIN_FRAC_BITS);
+    KiQ = toFixed(Ki, GAIN_FRAC_BITS);
+    KdQ = toFixed(Kd, GAIN_FRAC_BITS);
+    errorLimitP = KpQ ? TERM_LIMIT / labs(KpQ) : TERM_LIMIT;
+    errorLimitI = KiQ ? TERM_LIMIT / labs(KiQ) : TERM_LIMIT;
+    errorLimitD = KdQ ? TERM_LIMIT / labs(KdQ) : TERM_LIMIT;
+}
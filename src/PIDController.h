@@ -1,25 +1,93 @@
 #include <Romi32U4.h>
 #include <Arduino.h>
+#include "HAL.h"
 
 #pragma once
 
+/**
+ * PID on `input - setpoint`, so a positive output pushes the input down. Each
+ * call measures the time since the last one and scales the integral and
+ * derivative by it; the gains stay in units of one SAMPLE_MICROS step, the
+ * rate every controller here runs at, so a late or early loop only changes
+ * how much each step counts. The derivative is taken on the measurement
+ * (no kick when the setpoint moves) and can be low-pass filtered. With output
+ * limits set, the output saturates and the integral unwinds by the excess.
+ */
 class PIDController {
     public:
         PIDController();
         PIDController(float p, float i, float d);
+        PIDController(float p, float i, float d, bool fixed);
         void setPID(float p, float i, float d);
+        void setGains(float p, float i, float d);
+        void setFixedPoint(bool fixed);
+        bool isFixedPoint();
         void setSetpoint(float targetValue);
         void setTolerance(float t);
+        void setOutputLimit(float limit);
+        void setIntegralLimit(float limit);
+        void setDerivativeFilter(float seconds);
+        void reset();
         float calculateEffort(float inputData);
+        long calculateEffortFixed(float inputData);
         bool onTarget(float inputData);
         float getGainValue(int index);
         float getSetpoint();
+
+        // The step Ki and Kd are expressed in: the scheduler's 10ms, in whole ticks; actual steps are measured in microseconds
+        static const long SAMPLE_MICROS = 10 * HAL_TICK_MICROS;
+        // Fraction bits of `calculateEffortFixed()`'s result: shift right by this for the effort
+        static const int EFFORT_FRAC_BITS = 4 + 10;
     private:
+        unsigned long stepMicros();
+        void updateFixedPoint();
+        void updateFixedGains();
+
+        // Steps further apart than this count as this long, e.g. the first step after a pause
+        static const long MAX_STEP_MICROS = 4 * SAMPLE_MICROS;
+        static const long MIN_STEP_MICROS = SAMPLE_MICROS / 4;
+
         float setpoint = 0.0;
-        float errorSum = 0.0;
-        float previousError = 0.0;
+        float iTerm = 0.0;              // Integral, already multiplied by Ki
+        float dTerm = 0.0;              // Filtered derivative term
+        float previousInput = 0.0;
         float tolerance = 0.0;
+        float outputLimit = 0.0;        // 0 for no limit
+        float integralLimit = 0.0;
         float Kp = 1.0;
         float Ki = 0.0;
         float Kd = 0.0; 
+        long filterMicros = 0;          // Derivative filter time constant
+        unsigned long lastMicros = 0;
+        bool primed = false;            // False until the first step after a reset
+
+        // Fixed-point mode: inputs, setpoint and tolerance in Q.4, gains in Q.10,
+        // P/I/D terms, limits and the effort in Q.14, step lengths in Q.8 samples.
+        // Steps are the measured microseconds, and every division by a length of
+        // time is a multiply by a reciprocal from a table in flash, interpolated
+        // between whole ticks, so a step divides nothing however its length jitters.
+        //
+        // Headroom: each term is clamped below 2^29, i.e. 32768 effort units, so
+        // P + I + D stays below 2^31. That is 82 times the motors' full scale of
+        // 400. With the largest gain in use, Kp = 6, a term only clamps past an
+        // error of 5461; the fixed-point lifter (Kp = 5) clamps at 6553 counts,
+        // beyond its whole travel of about 3540.
+        static const int INPUT_FRAC_BITS = 4;
+        static const int GAIN_FRAC_BITS = 10;
+        static const int STEP_FRAC_BITS = 8;
+        static_assert(EFFORT_FRAC_BITS == INPUT_FRAC_BITS + GAIN_FRAC_BITS, "Effort is input times gain");
+        bool fixedPoint = false;
+        long setpointQ = 0;
+        long toleranceQ = 0;
+        long previousInputQ = 0;
+        long iTermQ = 0;
+        long dTermQ = 0;
+        long outputLimitQ = 0;
+        long integralLimitQ = 0;
+        long KpQ = 0;
+        long KiQ = 0;
+        long KdQ = 0;
+        long errorLimitP = 0;   // Largest |error| whose product with the gain cannot overflow
+        long errorLimitI = 0;
+        long errorLimitD = 0;
 };
\ No newline at end of file
@@ -1,57 +1,85 @@
 #include "Rangefinder.h"
+#include "EventQueue.h"
 
 
 static const int triggerPin = 12;
 static const int echoPin = 0;
-static unsigned long startTime;
-static unsigned long roundTripTime;
-static unsigned long pingTimer;    
+static unsigned long startTime;    // ISR only
 
 /**
  * Interrupt service routine for the echo pin
  * The echo pin goes high when the ultrasonic burst is sent out and goes low when the
  * echo is received. On the burst, the time is recorded, and on the echo the round trip
- * time is computed. This is used when requesting a distance by the getDistance methods.
+ * time is posted as an ECHO event, which the main loop hands to `Rangefinder::onEcho()`.
  */
 void ultrasonicISR()
 {
+    unsigned long now = micros();
     if (digitalRead(echoPin)) {
-        startTime = micros();
+        startTime = now;
     } else {
-        roundTripTime = micros() - startTime;
+        events.post(Event::ECHO, now - startTime, now);
     }
 }
 
 void Rangefinder::setup() {
-    pingTimer = 0;
     pinMode(triggerPin, OUTPUT);
     pinMode(echoPin, INPUT);
     attachInterrupt(digitalPinToInterrupt(echoPin), ultrasonicISR, CHANGE);
 }
 
+/**
+ * Collect the previous ping's echo and fire the next one. Call at a fixed rate,
+ * no faster than every 60ms so the previous echo has died out.
+ */
 void Rangefinder::loop() {
-    if(millis() > pingTimer) {
-        // trigger the ping
-        digitalWrite(triggerPin, LOW);
-        delayMicroseconds(2);
-        digitalWrite(triggerPin, HIGH);
-        delayMicroseconds(10);
-        digitalWrite(triggerPin, LOW);
-        pingTimer = millis() + 100;
-    }
+    collect();
+    ping();
+}
+
+/**
+ * Trigger a ping unconditionally. The echo ISR picks up the result; leave at
+ * least 60ms between pings so the previous echo has died out.
+ */
+void Rangefinder::ping() {
+    echoReady = false;
+    pingPending = true;
+
+    digitalWrite(triggerPin, LOW);
+    delayMicroseconds(2);
+    digitalWrite(triggerPin, HIGH);
+    delayMicroseconds(10);
+    digitalWrite(triggerPin, LOW);
+}
+
+/**
+ * Deliver an ECHO event. Echoes with no ping outstanding are ignored.
+ * @param roundTripMicros Time from the burst to the echo
+ * @param echoMicros micros() when the echo came back, from the event
+ */
+void Rangefinder::onEcho(unsigned long roundTripMicros, unsigned long echoMicros) {
+    if (!pingPending) return;
+    roundTripTime = roundTripMicros;
+    echoTime = echoMicros;
+    echoReady = true;
+}
+
+/**
+ * Fill in the range part of the tick's sensor frame
+ */
+void Rangefinder::sample(SensorFrame &frame) {
+    frame.range = getDistance();
+    frame.rangeFresh = isFresh();
+    frame.rangeMillis = outputTime;
 }
 
 /**
- * Return the distance of the ultrasonic sensor
+ * Return the filtered distance of the ultrasonic sensor: an EMA over the median
+ * of the recent samples. Check `isFresh()` before acting on it.
  * @return Detected distance in CM.
  */
 float Rangefinder::getDistanceCM() {
-    long rt;
-    cli();
-    rt = roundTripTime;
-    sei();
-    float distance = (rt * 0.0343) / 2.0;
-    return distance;
+    return distanceOutput;
 }
 
 /**
@@ -61,4 +89,70 @@ float Rangefinder::getDistanceCM() {
 float Rangefinder::getDistance() {
     float inches = getDistanceCM() * 0.393701;
     return inches;
-}
\ No newline at end of file
+}
+
+/**
+ * Whether the filtered distance can be trusted: enough recent echoes, and the
+ * newest one not too old (e.g. after a run of timed-out pings).
+ */
+bool Rangefinder::isFresh() {
+    return windowCount >= MIN_SAMPLES && getAge() <= MAX_AGE_MS;
+}
+
+/**
+ * @return Milliseconds since the newest echo that went into the filtered distance
+ */
+unsigned long Rangefinder::getAge() {
+    return millis() - outputTime;
+}
+
+/**
+ * @return Pings that got no echo, or one too long to be a real target
+ */
+unsigned int Rangefinder::getTimeouts() {
+    return timeouts;
+}
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+/**
+ * Take the last ping's round trip, if its echo came back. The sample is stamped
+ * with when the echo arrived, up to a range task period before now.
+ */
+void Rangefinder::collect() {
+    if (!pingPending) return;
+    pingPending = false;
+
+    if (!echoReady || roundTripTime > MAX_ROUND_TRIP_US) {
+        timeouts++;
+        return;
+    }
+    addSample((roundTripTime * 0.0343) / 2.0, millis() - (micros() - echoTime) / 1000);
+}
+
+/**
+ * Push a sample into the ring, then fold the median of the samples still inside
+ * the window into the EMA. The median throws out a single bad echo; the EMA
+ * smooths what is left.
+ */
+void Rangefinder::addSample(float cm, unsigned long timeMs) {
+    samples[nextSample] = {cm, timeMs};
+    nextSample = (nextSample + 1) % RING_LENGTH;
+    if (sampleCount < RING_LENGTH) sampleCount++;
+
+    float window[RING_LENGTH];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < sampleCount; i++) {
+        if (timeMs - samples[i].timeMs > WINDOW_MS) continue;
+        float v = samples[i].cm;
+        uint8_t j = n++;
+        for (; j > 0 && window[j - 1] > v; j--) window[j] = window[j - 1]; // Insertion sort
+        window[j] = v;
+    }
+    float median = (n % 2) ? window[n / 2] : (window[n / 2 - 1] + window[n / 2]) / 2.0;
+
+    bool restart = windowCount == 0 || timeMs - outputTime > MAX_AGE_MS;
+    distanceOutput = restart ? median : distanceOutput + EMA_ALPHA * (median - distanceOutput);
+    windowCount = n;
+    outputTime = timeMs;
+}
@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <Romi32U4.h>
+#include "SensorFrame.h"
 
 #pragma once
 
@@ -7,8 +8,39 @@ class Rangefinder {
     public:
         void setup();
         void loop();
+        void ping();
+        void onEcho(unsigned long roundTripMicros, unsigned long echoMicros);
+        void sample(SensorFrame &frame);
         float getDistanceCM();
         float getDistance();
+        bool isFresh();
+        unsigned long getAge();
+        unsigned int getTimeouts();
     private:
+        struct Sample {
+            float cm;
+            unsigned long timeMs;   // millis() when the echo came back
+        };
+
+        void collect();
+        void addSample(float cm, unsigned long timeMs);
+
+        static const uint8_t RING_LENGTH = 5;
+        const unsigned long WINDOW_MS = 300;            // Samples older than this are left out of the median
+        const uint8_t MIN_SAMPLES = 2;                  // Samples in the window before the reading is trusted
+        const unsigned long MAX_AGE_MS = 200;           // Newest sample must be younger than this to be trusted
+        const unsigned long MAX_ROUND_TRIP_US = 25000;  // About 4.3m; longer means the ping timed out
+        const float EMA_ALPHA = 0.6;                    // Weight of each new median
+
+        Sample samples[RING_LENGTH];
+        uint8_t nextSample = 0;
+        uint8_t sampleCount = 0;
+        uint8_t windowCount = 0;
+        bool pingPending = false;
+        bool echoReady = false;
+        unsigned long roundTripTime = 0;    // us, from the last ECHO event
+        unsigned long echoTime = 0;         // micros() when that echo came back
+        unsigned int timeouts = 0;
         float distanceOutput = 0;
-};
\ No newline at end of file
+        unsigned long outputTime = 0;
+};
@@ -0,0 +1,188 @@
+#include <Arduino.h>
+#include "Scheduler.h"
+#include "HAL.h"
+
+static volatile uint16_t ticks = 0;
+static void (*tickHook)() = 0;
+
+/**
+ * Start the timer tick. Tasks can be added before or after.
+ */
+void Scheduler::setup() {
+    halStartTick(tick);
+}
+
+/**
+ * @param fn Called from the tick interrupt, every tick. Must be short and must
+ *           not touch anything the tasks do not expect to change under them.
+ */
+void Scheduler::setTickHook(void (*fn)()) {
+    noInterrupts();
+    tickHook = fn;
+    interrupts();
+}
+
+/**
+ * Register a periodic task.
+ * @param name Name used by `report()`
+ * @param fn Function to run
+ * @param periodMs Desired period, in milliseconds (rounded to whole ticks)
+ * @param priority 0 is the most urgent
+ * @return Task id, or -1 (and a message on Serial) if the table is full
+ */
+int Scheduler::addTask(const char *name, TaskFunction fn, unsigned int periodMs, uint8_t priority) {
+    if (taskCount >= MAX_TASKS) {
+        Serial.print(F("  || Task table full (MAX_TASKS), not added: "));
+        Serial.println(name);
+        return -1;
+    }
+
+    unsigned long period = ((unsigned long)periodMs * 1000 + HAL_TICK_MICROS / 2) / HAL_TICK_MICROS;
+    if (period == 0) period = 1;
+
+    Task &task = tasks[taskCount];
+    task.name = name;
+    task.fn = fn;
+    task.periodTicks = period;
+    task.nextDue = getTicks();
+    task.priority = priority;
+    task.running = false;
+    task.overruns = 0;
+    task.maxMicros = 0;
+#ifdef TIMING_PROBES
+    task.lastStart = 0;
+    task.runtime.reset();
+    task.runtime.setDeadline(period * HAL_TICK_MICROS);
+    task.interval.reset();
+    task.interval.setDeadline((period + 1) * HAL_TICK_MICROS);
+#endif
+    return taskCount++;
+}
+
+/**
+ * Run every task that is due, always picking the most urgent one next. Call it
+ * from loop() only. Tasks must never run nested inside each other: sensorTask()
+ * would rewrite the frame a control task is halfway through. That is why there
+ * is no yield() hook, as USB Serial writes call delay() while they wait.
+ */
+void Scheduler::run() {
+    while (true) {
+        uint16_t now = getTicks();
+        Task *due = 0;
+        for (int i = 0; i < taskCount; i++) {
+            if (tasks[i].running || (int16_t)(now - tasks[i].nextDue) < 0) continue;
+            if (!due || tasks[i].priority < due->priority) due = &tasks[i];
+        }
+        if (!due) return;
+
+        uint16_t late = now - due->nextDue;
+        if (late >= due->periodTicks) {
+            uint16_t missed = late / due->periodTicks;
+            due->overruns += missed;
+            due->nextDue += missed * due->periodTicks;
+        }
+        due->nextDue += due->periodTicks;
+
+        due->running = true;
+        unsigned long start = micros();
+        due->fn();
+        unsigned long elapsed = micros() - start;
+        due->running = false;
+
+        if (elapsed > due->maxMicros) due->maxMicros = elapsed;
+#ifdef TIMING_PROBES
+        due->runtime.record(elapsed);
+        if (due->lastStart) due->interval.record(start - due->lastStart);
+        due->lastStart = start;
+#endif
+    }
+}
+
+/**
+ * Print period, worst-case runtime and overrun count for every task
+ */
+void Scheduler::report() {
+    for (int i = 0; i < taskCount; i++) {
+        Serial.print(tasks[i].name);
+        Serial.print("  || Period us: ");
+        Serial.print(tasks[i].periodTicks * HAL_TICK_MICROS);
+        Serial.print("  || Max us: ");
+        Serial.print(tasks[i].maxMicros);
+        Serial.print("  || Overruns: ");
+        Serial.println(tasks[i].overruns);
+    }
+#ifdef TIMING_PROBES
+    printTiming();
+#endif
+}
+
+/**
+ * Print the loop and per-task timing histograms (the `timing` Serial command)
+ */
+void Scheduler::printTiming() {
+#ifdef TIMING_PROBES
+    loopTiming.print("loop", "interval");
+    for (int i = 0; i < taskCount; i++) {
+        tasks[i].runtime.print(tasks[i].name, "run");
+        tasks[i].interval.print(tasks[i].name, "interval");
+    }
+#else
+    Serial.println("  || No timing histograms: build with -DTIMING_PROBES");
+#endif
+}
+
+/**
+ * Empty every timing histogram and the worst-case runtimes, e.g. to measure one
+ * phase of a run on its own
+ */
+void Scheduler::resetTiming() {
+    for (int i = 0; i < taskCount; i++) {
+        tasks[i].maxMicros = 0;
+#ifdef TIMING_PROBES
+        tasks[i].runtime.reset();
+        tasks[i].interval.reset();
+#endif
+    }
+#ifdef TIMING_PROBES
+    loopTiming.reset();
+#endif
+}
+
+unsigned int Scheduler::getOverruns(int id) {
+    return (id >= 0 && id < taskCount) ? tasks[id].overruns : 0;
+}
+
+unsigned long Scheduler::getMaxRuntime(int id) {
+    return (id >= 0 && id < taskCount) ? tasks[id].maxMicros : 0;
+}
+
+#ifdef TIMING_PROBES
+/**
+ * Call at the top of loop(). Records the time since the last pass: how long the
+ * scheduler can go without looking for due tasks.
+ */
+void Scheduler::markLoop() {
+    unsigned long now = micros();
+    if (lastLoop) loopTiming.record(now - lastLoop);
+    else loopTiming.setDeadline(HAL_TICK_MICROS);
+    lastLoop = now;
+}
+#endif
+
+// ----- PRIVATE CLASS METHODS BELOW ----- //
+
+/**
+ * Timer tick ISR
+ */
+void Scheduler::tick() {
+    ticks++;
+    if (tickHook) tickHook();
+}
+
+uint16_t Scheduler::getTicks() {
+    uint16_t t;
+    noInterrupts();
+    t = ticks;
+    interrupts();
+    return t;
+}
@@ -0,0 +1,63 @@
+#include <Arduino.h>
+#include "TimingHistogram.h"
+
+#pragma once
+
+typedef void (*TaskFunction)();
+
+/**
+ * Cooperative fixed-rate scheduler driven by the HAL timer tick. Tasks never
+ * preempt each other; run() dispatches whatever is due, highest priority first.
+ *
+ * Build with -DTIMING_PROBES to also keep, per task, histograms of runtime
+ * (deadline: the period) and of the interval between starts (deadline: the
+ * period plus one tick), and one of the time between loop() passes. Without it
+ * the histograms and `markLoop()` compile to nothing. With it they cost
+ * (2 * MAX_TASKS + 1) histograms of 42 bytes plus a start time per task, 750
+ * bytes of the 32U4's 2.5KB SRAM.
+ */
+class Scheduler {
+    public:
+        void setup();
+        void setTickHook(void (*fn)());
+        int addTask(const char *name, TaskFunction fn, unsigned int periodMs, uint8_t priority);
+        void run();
+        void report();
+        void printTiming();
+        void resetTiming();
+        unsigned int getOverruns(int id);
+        unsigned long getMaxRuntime(int id);
+#ifdef TIMING_PROBES
+        void markLoop();
+#else
+        void markLoop() {}
+#endif
+
+    private:
+        struct Task {
+            const char *name;
+            TaskFunction fn;
+            uint16_t periodTicks;
+            uint16_t nextDue;
+            uint8_t priority;           // 0 is the most urgent
+            bool running;
+            unsigned int overruns;      // Releases missed because the task started a full period late
+            unsigned long maxMicros;    // Worst-case runtime
+#ifdef TIMING_PROBES
+            unsigned long lastStart;
+            TimingHistogram runtime;
+            TimingHistogram interval;   // Start to start; its max bounds the task's response time
+#endif
+        };
+
+        static void tick();
+        uint16_t getTicks();
+
+        static const int MAX_TASKS = 8;     // main.cpp uses all of them; each more costs 16 bytes (104 with TIMING_PROBES)
+        Task tasks[MAX_TASKS];
+        int taskCount = 0;
+#ifdef TIMING_PROBES
+        TimingHistogram loopTiming;
+        unsigned long lastLoop = 0;
+#endif
+};
@@ -0,0 +1,24 @@
+#include <Arduino.h>
+
+#pragma once
+
+/**
+ * One coherent view of the sensors, captured once per 10ms control tick by the
+ * sensor task in main.cpp and passed to every consumer in that tick. Each raw
+ * reading is taken in one place and converted once, so two decisions made in
+ * the same tick can never disagree about where the lifter is or how far the
+ * wall is.
+ */
+struct SensorFrame {
+    unsigned long micros = 0;   // When the frame was captured
+    float lifterPosition = 0;   // Motor degrees, positive down (BlueMotor::getPosition())
+    float lifterVelocity = 0;   // Motor degrees per second (BlueMotor::getVelocity())
+    float range = 0;            // Filtered ultrasonic distance, inches
+    bool rangeFresh = false;    // Rangefinder::isFresh() when captured
+    unsigned long rangeMillis = 0;  // millis() when the newest echo in `range` came back
+    uint16_t lineLeft = 0;      // Raw reflectance, 0 - 1023
+    uint16_t lineRight = 0;
+    float lineOffset = 0;       // Tape position, -1 (right) to 1 (left); only meaningful with confidence
+    float lineConfidence = 0;   // 0 (no tape under either sensor) to 1
+    uint16_t intersections = 0; // LineSensor::getIntersections()
+};
@@ -0,0 +1,86 @@
+#include <Arduino.h>
+#include "Telemetry.h"
+
+static_assert(sizeof(TelemetryRecord) == 31, "TelemetryRecord layout is shared with tools/telemetry_decode.py");
+
+Telemetry telemetry;
+
+static int16_t toQ10(float gain) {
+    return (int16_t)constrain(gain * 1024.0, -32768.0, 32767.0);
+}
+
+void Telemetry::setEnabled(bool enabled) {
+    this->enabled = enabled;
+}
+
+bool Telemetry::isEnabled() {
+    return enabled;
+}
+
+/**
+ * Set the mission step stamped on every record from now on
+ * @param step Index in the mission table of the first step of the group that is running
+ */
+void Telemetry::setStep(uint8_t step) {
+    this->step = step;
+}
+
+/**
+ * Queue one controller sample. Never blocks; drops the sample if the queue is full.
+ * Task context only: the queue is not protected against interrupts.
+ * @param channel Telemetry::Channel the sample came from
+ * @param position Measured value
+ * @param setpoint Target value
+ * @param output Raw PID output
+ * @param applied Effort sent to the motor driver
+ * @param confidence Line estimate confidence in percent, 0 where there is none
+ */
+void Telemetry::send(uint8_t channel, float position, float setpoint, float output, int applied,
+                     uint8_t confidence, float kp, float ki, float kd) {
+    if (!enabled) return;
+    if (count >= QUEUE_LENGTH) {
+        dropped++;
+        seq++;  // Keep the gap visible on the host
+        return;
+    }
+
+    TelemetryRecord &r = queue[(head + count) % QUEUE_LENGTH];
+    r.sync[0] = 0xA5;
+    r.sync[1] = 0x5A;
+    r.seq = seq++;
+    r.timestamp = micros();
+    r.step = step;
+    r.channel = channel;
+    r.position = position;
+    r.setpoint = setpoint;
+    r.output = output;
+    r.applied = (int16_t)applied;
+    r.confidence = confidence;
+    r.gains[0] = toQ10(kp);
+    r.gains[1] = toQ10(ki);
+    r.gains[2] = toQ10(kd);
+
+    const uint8_t *bytes = (const uint8_t *)&r;
+    uint8_t sum = 0;
+    for (uint8_t i = 2; i < sizeof(TelemetryRecord) - 1; i++) sum += bytes[i];
+    r.checksum = sum;
+
+    count++;
+}
+
+/**
+ * Hand queued records to Serial, whole records only and only while Serial can
+ * take them without waiting. Any text printed elsewhere therefore lands between
+ * records, where the host decoder skips it.
+ */
+void Telemetry::loop() {
+    while (count > 0 && Serial.availableForWrite() >= (int)sizeof(TelemetryRecord)) {
+        Serial.write((const uint8_t *)&queue[head], sizeof(TelemetryRecord));
+        head = (head + 1) % QUEUE_LENGTH;
+        count--;
+    }
+}
+
+unsigned int Telemetry::getDropped() {
+    return dropped;
+}
@@ -0,0 +1,58 @@
+#include <Arduino.h>
+
+#pragma once
+
+/**
+ * One controller sample on the wire. Little-endian, no padding, 31 bytes.
+ * Decoded on the host by tools/telemetry_decode.py.
+ */
+struct __attribute__((packed)) TelemetryRecord {
+    uint8_t sync[2];        // 0xA5 0x5A
+    uint8_t seq;            // Rolling sequence number; gaps on the host mean dropped records
+    uint32_t timestamp;     // micros()
+    uint8_t step;           // Mission step group running: index of its first step in the table (Mission::getStep())
+    uint8_t channel;        // Telemetry::Channel
+    float position;
+    float setpoint;
+    float output;           // Raw PID output
+    int16_t applied;        // Effort actually sent to the motor driver
+    uint8_t confidence;     // Line estimate confidence in percent (LINE_FOLLOW); 0 on other channels
+    int16_t gains[3];       // Kp, Ki, Kd in Q.10
+    uint8_t checksum;       // Sum of every byte from seq to gains, mod 256
+};
+
+/**
+ * Framed binary telemetry. `send()` queues a fixed-size record and never blocks:
+ * if the queue is full the record is dropped and counted. `loop()` hands whole
+ * records to Serial only when it has room for them, so a slow or absent host
+ * cannot stall the control loop.
+ */
+class Telemetry {
+    public:
+        enum Channel {
+            LIFTER = 0,     // position/setpoint in motor degrees
+            CHASSIS = 1,    // position/setpoint in inches from the ultrasonic sensor
+            LINE = 2,       // position = left sensor, setpoint = right sensor, applied = (leftDrive << 1) | rightDrive
+            LINE_FOLLOW = 3 // position = line offset, output = steering in in/s, applied = 0, confidence set
+        };
+
+        void setEnabled(bool enabled);
+        bool isEnabled();
+        void setStep(uint8_t step);
+        void send(uint8_t channel, float position, float setpoint, float output, int applied,
+                  uint8_t confidence, float kp, float ki, float kd);
+        void loop();
+        unsigned int getDropped();
+
+    private:
+        static const uint8_t QUEUE_LENGTH = 4;
+        TelemetryRecord queue[QUEUE_LENGTH];
+        uint8_t head = 0;
+        uint8_t count = 0;
+        uint8_t seq = 0;
+        uint8_t step = 0;
+        bool enabled = false;
+        unsigned int dropped = 0;
+};
+
+extern Telemetry telemetry;
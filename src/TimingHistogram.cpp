@@ -0,0 +1,63 @@
+#ifdef TIMING_PROBES
+
+#include <Arduino.h>
+#include "TimingHistogram.h"
+
+/**
+ * @param deadlineMicros Samples longer than this count as misses; 0 for none
+ */
+void TimingHistogram::setDeadline(unsigned long deadlineMicros) {
+    deadline = deadlineMicros;
+}
+
+void TimingHistogram::record(unsigned long elapsedMicros) {
+    uint8_t bucket = 0;
+    if (elapsedMicros > 1) { // __builtin_clzl(0) is undefined
+        uint8_t log2 = sizeof(unsigned long) * 8 - 1 - __builtin_clzl(elapsedMicros);
+        bucket = (log2 < BUCKETS - 1) ? log2 : BUCKETS - 1;
+    }
+    if (buckets[bucket] != 0xFFFF) buckets[bucket]++;
+
+    if (elapsedMicros > maxMicros) maxMicros = elapsedMicros;
+    if (deadline && elapsedMicros > deadline && misses != 0xFFFF) misses++;
+}
+
+void TimingHistogram::reset() {
+    for (uint8_t i = 0; i < BUCKETS; i++) buckets[i] = 0;
+    misses = 0;
+    maxMicros = 0;
+}
+
+/**
+ * Print the max, the misses and every non-empty bucket as "<upper bound us: count"
+ * @param name Task or probe name
+ * @param what What was measured, e.g. "run" or "interval"
+ */
+void TimingHistogram::print(const char *name, const char *what) {
+    Serial.print(name);
+    Serial.print(" ");
+    Serial.print(what);
+    Serial.print("  || Max us: ");
+    Serial.print(maxMicros);
+    if (deadline) {
+        Serial.print("  || Over ");
+        Serial.print(deadline);
+        Serial.print(": ");
+        Serial.print(misses);
+    }
+    Serial.println();
+
+    Serial.print("   ");
+    for (uint8_t i = 0; i < BUCKETS; i++) {
+        if (!buckets[i]) continue;
+        Serial.print(" ");
+        if (i == BUCKETS - 1) Serial.print(">=");
+        else Serial.print("<");
+        Serial.print(i == BUCKETS - 1 ? (1UL << i) : (2UL << i));
+        Serial.print(": ");
+        Serial.print(buckets[i]);
+    }
+    Serial.println();
+}
+
+#endif
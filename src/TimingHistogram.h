@@ -0,0 +1,29 @@
+#include <Arduino.h>
+
+#pragma once
+
+/**
+ * Log-scale histogram of durations in microseconds, for finding where the
+ * control loop spends its time. Bucket n counts samples in [2^n, 2^(n+1)) us
+ * (bucket 0 also takes 0us) and the last bucket everything from 2^15 us up, so
+ * 32 bytes of counts cover 1us to over 30ms at a constant relative resolution;
+ * with the miss count, maximum and deadline one histogram takes 42 bytes.
+ * `record()` finds the bucket with one count-leading-zeros instead of shifting
+ * a bit at a time (on the AVR that is libgcc's __clzsi2, which skips zero bytes
+ * whole). Only built with TIMING_PROBES.
+ */
+class TimingHistogram {
+    public:
+        static const uint8_t BUCKETS = 16;
+
+        void setDeadline(unsigned long deadlineMicros);
+        void record(unsigned long elapsedMicros);
+        void reset();
+        void print(const char *name, const char *what);
+
+    private:
+        uint16_t buckets[BUCKETS] = {0};    // Saturate at 65535 instead of wrapping
+        uint16_t misses = 0;                // Samples longer than the deadline
+        unsigned long maxMicros = 0;
+        unsigned long deadline = 0;         // 0 for none
+};
@@ -7,11 +7,20 @@
 #include <Romi32U4.h>
 #include "Chassis.h"
 #include "BlueMotor.h"
-#include "RangeFinder.h"
+#include "Rangefinder.h"
 #include "servo32u4.h"
 #include "RemoteConstants.h"
 #include "IRdecoder.h"
 #include "LineSensor.h"
+#include "Benchmark.h"
+#include "Scheduler.h"
+#include "Telemetry.h"
+#include "Mission.h"
+#include "Calibration.h"
+#include "EStop.h"
+#include "HAL.h"
+#include "EventQueue.h"
+#include "SensorFrame.h"
 
 Chassis chassis;
 BlueMotor blueMotor;
@@ -21,64 +30,81 @@ Romi32U4ButtonA pushButton;
 Romi32U4ButtonB pushButtonB;
 IRDecoder decoder;
 LineSensor lineSensor;
+Benchmark benchmark;
+Scheduler scheduler;
+Mission mission(chassis, blueMotor, servo);
+SensorFrame frame;  // This tick's sensor readings; see sensorTask()
 
 // ----- CONFIG START ----- //
 const bool TESTING = false;             // Enable testing sequence instead of autonomous sequence
+const bool BENCHMARK = false;           // Print cycle-count benchmarks over Serial at boot
+const bool TELEMETRY = false;           // Stream binary controller records over Serial (tools/telemetry_decode.py)
 const bool SKIP_TRAVERSE = true;        // Skip the ambitious traversal across the field to the other side
 const bool ALUM_PLATE = true;           // Switch for aluminum-plate-specific code
 bool AUTO_2 = false;
-const float GEAR_RATIO_LIFTER = 30.8;   // Lifter gear ratio
+constexpr float GEAR_RATIO_LIFTER = 30.8;   // Lifter gear ratio
 
                                         // LIFTER POSITIONS BELOW MUST BE MULTIPLIED BY GEAR RATIO
-const float LIFTER_MAX = -142.0;        // Max height for the lifter, if zeroed when linkage touches nut
-const float LIFTER_PLATFORM = -15.0;     // Lifter position for height of platform
-const float LIFTER_25ROOF = -115.0;     // Lifter position for height of 25-degree roof
-const float LIFTER_45ROOF = -81.5;      // Lifter position for height of 45-degree roof
-const float DIST_PLATFORM = 13.75 - 2.0;      // Distance (in.) between front of robot and platform with wheels on intersection
-const float DIST_ROOF = 13.45 - 3.0;          // DIstance (in.) between front of robot and roof inner panel with wheels on intersection
+constexpr float LIFTER_MAX = -142.0;    // Max height for the lifter, if zeroed when linkage touches nut
+constexpr float LIFTER_PLATFORM = -15.0; // Lifter position for height of platform
+constexpr float LIFTER_25ROOF = -115.0; // Lifter position for height of 25-degree roof
+constexpr float LIFTER_45ROOF = -81.5;  // Lifter position for height of 45-degree roof
+constexpr float DRIVE_SPEED = 5.0;      // Wheel speed (in/s) for driving up to and away from the structures
+constexpr float DIST_PLATFORM = 13.75 - 2.0;  // Distance (in.) between front of robot and platform with wheels on intersection
+constexpr float DIST_ROOF = 13.45 - 3.0;      // DIstance (in.) between front of robot and roof inner panel with wheels on intersection
 const int GRIPPER_CLOSED = 815;         // Servo position for closed gripper
 const int GRIPPER_OPEN = 1700;          // Servo position for open gripper
+constexpr float LIFTER_KP = 5.0;        // Lifter gains; remote 9 in manual adjustment mode measures new ones
+constexpr float LIFTER_KI = 0.03;
+constexpr float LIFTER_KD = 0.1;
+const int LINE_TABLE = 60;              // Line sensor reading over the lab table; remote 8 in manual adjustment mode measures both
+const int LINE_TAPE = 800;              // Line sensor reading over the black tape
+const int LIFTER_GRAVITY = 0;           // Lifter gravity feedforward, every 512 motor degrees: none until remote 6 in manual adjustment mode measures it
+
+/* The values above that the missions read are only defaults: a block saved in EEPROM
+ * overrides them at boot. Type "cal" in the Serial monitor to list or change them. */
+const float CALIBRATION_DEFAULTS[Calibration::COUNT] PROGMEM = {
+    0.0, GRIPPER_OPEN, GRIPPER_CLOSED, GEAR_RATIO_LIFTER, LIFTER_PLATFORM, LIFTER_25ROOF, LIFTER_45ROOF,
+    DIST_PLATFORM, DIST_ROOF, LIFTER_KP, LIFTER_KI, LIFTER_KD, LINE_TABLE, LINE_TAPE, LINE_TABLE, LINE_TAPE,
+    LIFTER_GRAVITY, LIFTER_GRAVITY, LIFTER_GRAVITY, LIFTER_GRAVITY, LIFTER_GRAVITY,
+    LIFTER_GRAVITY, LIFTER_GRAVITY, LIFTER_GRAVITY, LIFTER_GRAVITY, LIFTER_GRAVITY
+};
+static_assert(Calibration::LIFTER_GRAVITY_9 - Calibration::LIFTER_GRAVITY_0 + 1 == BlueMotor::GRAVITY_POINTS,
+              "one calibration value per gravity table point");
 
 /* Additional configuration parameters can be found in the header files of specific classes.*/
 // ----- CONFIG END -----//
 
-bool paused = false;
 bool tweak = false;
+unsigned int reportedFaults = 0;    // Lifter encoder faults already printed by eventTask()
 
-enum States {
-    SETUP_RAISE,
-    CONFIRM_SETUP,
-    GRIPPING_1,
-    CONFIRM_1,
-    DRIVE_REV_LOWER_1,
-    TURN_LEFT_1,
-    DRIVE_FWD_PLATFORM,
-    CONFIRM_2, 
-    RELEASE_1,
-    CONFIRM_3,
-    GRIPPING_2,
-    DRIVE_REV_LIFT_1,
-    TURN_RIGHT_1,
-    DRIVE_FWD_ROOF,
-    CONFIRM_DEPOSIT,
-    RELEASE_2,
-
-    IDLE,           // Universal Idle
-    STOPPED         // Universal E-Stop
-} state;
-
-const char *stateNames[] = {"SETUP_RAISE", "CONFIRM_SETUP", "GRIPPING_1", "CONFIRM_1", "DRIVE_REV_LOWER_1", 
-    "TURN_LEFT_1", "DRIVE_FWD_PLATFORM", "CONFIRM_2", "RELEASE_1", "CONFIRM_3", "GRIPPING_2", "DRIVE_REV_LIFT_1", 
-    "TURN_RIGHT_1", "DRIVE_FWD_ROOF", "CONFIRM_DEPOSIT", "RELEASE_2", "IDLE", "STOPPED"};
-
-void checkRemote() {
-    int keyCode = decoder.getKeyCode();
-    if (keyCode == remotePlayPause) { // E-Stop Feature
-        if(paused) {
-            delay(250); // Attempt to stop bouncing
-        }
-        paused = !paused;
-        Serial.println(paused ? "Paused" : "Running");
+/**
+ * Print the SRAM left between the heap and the stack, now and at the stack's deepest
+ * so far. Check the second number after adding buffers (tools/ram_report.py shows
+ * where the static RAM goes).
+ */
+void printMemory() {
+    Serial.print("SRAM  || Free now: ");
+    Serial.print(halFreeRam());
+    Serial.print("  || Stack headroom: ");
+    Serial.println(halStackUnused());
+}
+
+/**
+ * Act on a remote key, delivered as a KEY event
+ */
+void handleKey(int keyCode) {
+    if (keyCode == remotePlayPause && estop.isTripped()) {
+        if (estop.clear()) {
+            blueMotor.resume(); // Profiles and timers ran on through the pause
+            chassis.resume();
+            mission.resume(millis() - estop.getTripMillis());
+            Serial.println("Running");
+        }
+    } else if (keyCode == remotePlayPause && mission.isAwaitingConfirm()) {
+        mission.confirm();
+    } else if (keyCode == remotePlayPause) { // Only if the tick interrupt missed it
+        estop.trip();
     } else if (keyCode == remoteSetup) {
         tweak = !tweak;
         Serial.println(tweak ? "Manual adjustment mode" : "Normal mode");
@@ -93,13 +119,29 @@ void checkRemote() {
         blueMotor.setEffort(0);
     } else if (keyCode == remoteLeft && tweak) {
         Serial.println("Left Button: Gripper Open");
-        servo.Write(GRIPPER_OPEN);
+        servo.Write(calibration.get(Calibration::GRIPPER_OPEN));
     } else if (keyCode == remoteRight && tweak) {
         Serial.println("Left Button: Gripper Closed");
-        servo.Write(GRIPPER_CLOSED);
+        servo.Write(calibration.get(Calibration::GRIPPER_CLOSED));
+    } else if (keyCode == remote9 && tweak) {
+        Serial.println("9 Button: Auto-tuning lifter about its current position");
+        blueMotor.startAutoTune();
+    } else if (keyCode == remote6 && tweak) {
+        Serial.println("6 Button: Measuring the lifter gravity table, lifting to the top in steps");
+        blueMotor.startGravityScan(LIFTER_MAX * calibration.get(Calibration::GEAR_RATIO_LIFTER));
+    } else if (keyCode == remote8 && tweak) {
+        Serial.println("8 Button: Calibrating line sensors, spinning over the tape");
+        lineSensor.startCalibration();
+        chassis.startTurn(360);
     } else if (keyCode == remote7) {
         AUTO_2 = true;
         Serial.println("AUTO 2 ENABLED");
+    } else if (keyCode == remote0) {
+        scheduler.report();
+        estop.report();
+        printMemory();
+        Serial.print("Events  || Dropped: ");
+        Serial.println(events.getDropped());
     }
 }
 
@@ -122,14 +164,14 @@ void testSequence() {
     //     Serial.println("Target reached");
     // }
 
-    lineSensor.loop();
     //lineSensor.setLineFollowForward();
     //chassis.setEffortsBoolean(lineSensor.leftDrive, lineSensor.rightDrive);
-    chassis.startLinePID(lineSensor.readSensor(true), lineSensor.readSensor(false));
+    if(lineSensor.isAtIntersection()) chassis.drive(0);
+    else chassis.startLineFollow(DRIVE_SPEED);
 }
 
 /*
-Autonomous state machine for removing and placing a panel on the 25-degree roof.
+Autonomous sequence for removing and placing a panel on the 25-degree roof.
 Start directly under the 25 deg roof, gripper open.
 1. Close Gripper                            2. Wait for confirm, Back up X CM
 3. Lower Arm to platform height (2in)       4. Go back to platform using line follow + dead reckon
@@ -137,489 +179,246 @@ Start directly under the 25 deg roof, gripper open.
 7. Lift arm to 25 deg height                8. Return to structure with line follow + dead + ultrasonic (last leg)
 9. Wait for confirm, Open Gripper           10. Back up X CM
 */
-const bool skip_ir = true;
-
-void autoSequence1() {
-    static States previousState = IDLE;
-    if (state != previousState) {
-        Serial.println(stateNames[state]);
-        previousState = state;
-    } 
-
-    switch (state) {
-        case SETUP_RAISE:
-        // Raise the arm from its zeroed position then open gripper.
-        blueMotor.startMoveTo((LIFTER_25ROOF+1) * GEAR_RATIO_LIFTER);
-        blueMotor.loopController();
-        if (blueMotor.pullOnTarget()) {
-            Serial.println("Lifter arm movement complete");
-            blueMotor.setEffort(0);
-            servo.Write(GRIPPER_OPEN);
-            state = CONFIRM_SETUP;
-        }
-        break;
-
-        case CONFIRM_SETUP:
-        // Wait for confirmation from user that robot is properly placed
-        static int tempCount1 = 0;
-        if(tempCount1 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount1++;
-            if(skip_ir) {
-                delay(10000);
-                paused = false;
-            }
-        }
+const bool skip_ir = true;  // Confirm steps time out instead of waiting for the remote
+
+const MissionStep ROOF_25[] PROGMEM = {
+    stepLiftTo(Calibration::LIFTER_25ROOF, 1.0),        // Raise the arm from its zeroed position
+    stepGripTo(Calibration::GRIPPER_OPEN),
+    stepConfirm(10000),                                 // Robot properly placed
+    stepGripTo(Calibration::GRIPPER_CLOSED),
+    stepConfirm(5000),                                  // Plate securely gripped
+    together(stepLiftTo(Calibration::LIFTER_PLATFORM, ALUM_PLATE ? -14.5 : 0.0)),
+    stepDriveUntilFarther(-DRIVE_SPEED, -DRIVE_SPEED, Calibration::DIST_ROOF, 0.0), // Back up to the intersection while lowering
+    stepTurn(-90),                                      // Face the platform
+    stepDriveUntilCloser(DRIVE_SPEED, DRIVE_SPEED, 2.5),
+    stepConfirm(5000),                                  // Plate placed on platform
+    stepGripTo(Calibration::GRIPPER_OPEN),
+    stepConfirm(5000),                                  // Old plate removed, new plate on platform
+    stepGripTo(Calibration::GRIPPER_CLOSED),
+    stepWait(250),
+    together(stepDriveUntilFarther(-DRIVE_SPEED, -DRIVE_SPEED, Calibration::DIST_PLATFORM, -0.3)),
+    stepLiftTo(Calibration::LIFTER_25ROOF, 0.0),        // Back up while raising to roof height
+    stepTurn(90),                                       // Face the roof
+    stepDriveUntilCloser(DRIVE_SPEED, DRIVE_SPEED, 4.14),
+    stepConfirm(5000),                                  // Plate aligned with roof
+    stepGripTo(Calibration::GRIPPER_OPEN),
+    stepWait(500),
+    stepDriveUntilFarther(-DRIVE_SPEED, -DRIVE_SPEED, Calibration::DIST_ROOF, 0.0), // Back up to the line again
+    stepEnd()
+};
 
-        if(!paused) state = GRIPPING_1;
-        break;
-
-        case GRIPPING_1:
-        // Close gripper on existing plate for removal
-        servo.Write(GRIPPER_CLOSED);
-        state = CONFIRM_1;
-        break;
-        
-        case CONFIRM_1:
-        // Wait for confirmation from user that plate is securely gripped
-        static int tempCount2 = 0;
-        if(tempCount2 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount2++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
-        }
-
-        if(!paused) {
-            //chassis.startUltraDrive(DIST_ROOF, rangeFinder.getDistance());
-            chassis.drive(-75);
-            state = DRIVE_REV_LOWER_1;
-        }
-        break;
-
-        case DRIVE_REV_LOWER_1:
-        // Ultrasonic and drive in reverse until intersection, also lower arm to platform height
-        //chassis.loopUltraPID(rangeFinder.getDistance());
-        Serial.print("Dist: ");
-        Serial.println(rangeFinder.getDistance());
-        
-        if(ALUM_PLATE) {
-            blueMotor.startMoveTo((LIFTER_PLATFORM-14.5) * GEAR_RATIO_LIFTER);
-        } else {
-            blueMotor.startMoveTo(LIFTER_PLATFORM * GEAR_RATIO_LIFTER);
-        }
-        blueMotor.loopController();
-        if (blueMotor.pullOnTarget()) {
-            Serial.println("Lifter arm movement complete");
-            blueMotor.setEffort(0);
-        }
-        /*if(chassis.pullOnTarget(rangeFinder.getDistance())) {
-            chassis.drive(0);
-            Serial.println("Chassis target reached");
-        }*/
-        if(rangeFinder.getDistance() >= DIST_ROOF) {
-            Serial.println("Chassis target reached");
-            chassis.drive(0);
-        }
-        if(rangeFinder.getDistance() >= DIST_ROOF/*chassis.pullOnTarget(rangeFinder.getDistance())*/ && blueMotor.pullOnTarget()) {
-            Serial.println("both complete");
-            state = TURN_LEFT_1;
-            chassis.startTurn(-87);
-        }
-        break;
-
-        case TURN_LEFT_1:
-        // Turn left 90 degrees to face platform
-        if(chassis.turnComplete()) {
-            Serial.println("Turn 90 left complete");
-            chassis.drive(0);
-            state = DRIVE_FWD_PLATFORM;
-            delay(1000);
-            chassis.setEfforts(72,75);
-            //chassis.startUltraDrive(2.5, rangeFinder.getDistance());
-        }
-        break;
-
-        case DRIVE_FWD_PLATFORM:
-        // Drive to platform with linefollow/ultrasonic/both
-        //chassis.loopUltraPID(rangeFinder.getDistance());
-        if(rangeFinder.getDistance() <= 2.5) {
-        //if(chassis.pullOnTarget(rangeFinder.getDistance())) {
-            Serial.println("Chassis target reached");
-            chassis.drive(0);
-            state = CONFIRM_2;
-        }
-        break;
-
-        case CONFIRM_2:
-        // Wait for confirmation from user that plate is placed on platform
-        static int tempCount3 = 0;
-        if(tempCount3 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount3++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
-        }
+/*
+Autonomous sequence for removing and placing a panel on the 45-degree roof.
+Start directly under the 45 deg roof, gripper open.
+*/
+const MissionStep ROOF_45[] PROGMEM = {
+    stepLiftTo(Calibration::LIFTER_45ROOF, 0.0),
+    stepGripTo(Calibration::GRIPPER_OPEN),
+    stepConfirm(5000),                                  // Robot properly placed
+    stepGripTo(Calibration::GRIPPER_CLOSED),
+    stepConfirm(5000),                                  // Plate securely gripped
+    stepDriveUntilFarther(-DRIVE_SPEED, -DRIVE_SPEED, Calibration::DIST_ROOF, 2.35), // Clear the roof before lowering
+    stepLiftTo(Calibration::LIFTER_PLATFORM, 0.0),
+    stepTurn(90),                                       // Face the platform
+    stepDriveUntilCloser(DRIVE_SPEED, DRIVE_SPEED, 2.25),
+    stepConfirm(5000),                                  // Plate placed on platform
+    stepGripTo(Calibration::GRIPPER_OPEN),
+    stepConfirm(5000),                                  // Old plate removed, new plate on platform
+    stepGripTo(Calibration::GRIPPER_CLOSED),
+    stepWait(250),
+    together(stepDriveUntilFarther(-DRIVE_SPEED, -DRIVE_SPEED, Calibration::DIST_PLATFORM, 6.5)),
+    stepLiftTo(Calibration::LIFTER_45ROOF, 0.0),        // Back up while raising to roof height
+    stepTurn(-90),                                      // Face the roof
+    stepDriveUntilCloser(DRIVE_SPEED, DRIVE_SPEED, 4.84),
+    stepConfirm(5000),                                  // Plate aligned with roof
+    stepGripTo(Calibration::GRIPPER_OPEN),
+    stepWait(500),
+    stepDriveUntilFarther(-DRIVE_SPEED, -DRIVE_SPEED, Calibration::DIST_ROOF, 0.0), // Back up to the line again
+    stepEnd()
+};
+
+// ----- Scheduled tasks ----- //
 
-        if(!paused) state = RELEASE_1;
-        break;
-
-        case RELEASE_1:
-        // Open gripper to place plate on platform
-        servo.Write(GRIPPER_OPEN);
-        state = CONFIRM_3;
-        break;
-
-        case CONFIRM_3:
-        // Wait for confirmation from user that old plate is removed and new plate is on platform
-        static int tempCount4 = 0;
-        if(tempCount4 == 0) {
-            Serial.println("Awaiting user confirmation");
-            paused = true;
-            tempCount4++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
+/**
+ * Hand everything the interrupts queued since the last pass to its owner, and
+ * report lifter encoder faults counted since then
+ */
+void eventTask() {
+    Event event;
+    while (events.pop(event)) {
+        switch (event.type) {
+            case Event::ECHO:
+            rangeFinder.onEcho(event.value, event.micros);
+            break;
+
+            case Event::KEY:
+            handleKey(event.value);
+            break;
         }
+    }
 
-        if(!paused) state = GRIPPING_2;
-        break;
-
-        case GRIPPING_2:
-        // Close gripper on new plate
-        servo.Write(GRIPPER_CLOSED);
-        delay(250);
-        state = DRIVE_REV_LIFT_1;
-        chassis.setEfforts(-75, -75);
-        break;
-
-        case DRIVE_REV_LIFT_1:
-        // Line follow and drive in reverse until intersection, also raise arm to 25 deg roof height
-        if(rangeFinder.getDistance() >= DIST_PLATFORM-0.3) {
-            Serial.println("Chassis target reached.");
-            chassis.drive(0);
-        }
-        blueMotor.startMoveTo(LIFTER_25ROOF * GEAR_RATIO_LIFTER);
-        blueMotor.loopController();
-        if (blueMotor.pullOnTarget()) {
-            Serial.println("Lifter arm movement complete");
-            blueMotor.setEffort(0);
-            state = TURN_RIGHT_1;
-            chassis.startTurn(84);
-        }
-        break;
-
-        case TURN_RIGHT_1:
-        // Turn right 90 degrees to face roof
-        if(chassis.turnComplete()) {
-            Serial.println("Turn 90 right complete");
-            chassis.drive(0);
-            state = DRIVE_FWD_ROOF;
-            delay(500);
-            chassis.setEfforts(65, 75);
-        }
-        break;
-
-        case DRIVE_FWD_ROOF:
-        // Drive to roof with linefollow/ultrasonic/both
-        if(rangeFinder.getDistance() <= 4.14) {
-            Serial.println("Chassis target reached.");
-            chassis.drive(0);
-            state = CONFIRM_DEPOSIT;
-        }
-        break;
-
-        case CONFIRM_DEPOSIT:
-        // Wait for confirmation from user that plate is alligned with roof
-        static int tempCount5 = 0;
-        if(tempCount5 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount5++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
-        }
+    unsigned int faults = blueMotor.getErrorCount();
+    if (faults != reportedFaults) {
+        Serial.print("  || Lifter encoder faults: ");
+        Serial.println(faults - reportedFaults);
+        reportedFaults = faults;
+    }
+}
 
-        if(!paused) state = RELEASE_2;
-        break;
-
-        case RELEASE_2:
-        // Open gripper to place plate on 25 deg roof and back up to line again
-        servo.Write(GRIPPER_OPEN);
-        static int tempCount6 = 0;
-        if(tempCount6 == 0) {
-            delay(500);
-            chassis.setEfforts(-75,-75);
-            tempCount6++;
-        }
-        if(rangeFinder.getDistance() >= DIST_ROOF) {
-            Serial.println("Chassis target reached.");
-            chassis.drive(0);
-            state = IDLE;
-        }
-        break;
+void remoteTask() {
+    if (estop.takeTripEvent()) Serial.println("Paused (E-stop)");
+    estop.setArmed(!mission.isAwaitingConfirm());
+    calibration.loop();
+}
 
-        case IDLE:
-        Serial.println("Autonomous sequence complete.");
-        break;
+void rangeTask() {
+    rangeFinder.loop();
+}
 
-        case STOPPED:
-        paused = true;
-        break;
+/**
+ * End of the remote 6 gravity scan: keep the measured table across power cycles
+ */
+void finishGravityScan() {
+    uint8_t params[BlueMotor::GRAVITY_POINTS];
+    float efforts[BlueMotor::GRAVITY_POINTS];
+    for(uint8_t i = 0; i < BlueMotor::GRAVITY_POINTS; i++) {
+        params[i] = Calibration::LIFTER_GRAVITY_0 + i;
+        efforts[i] = blueMotor.pullGravity(i);
     }
+    calibration.set(params, efforts, BlueMotor::GRAVITY_POINTS);
+    Serial.println(calibration.save() ? "  || Gravity table saved" : "  || Gravity table not saved: EEPROM write failed");
 }
 
-/*
-Autonomous state machine for removing and placing a panel on the 45-degree roof.
-Start directly under the 45 deg roof, gripper open.
-*/
-void autoSequence2() {
-    static States previousState = IDLE;
-    if (state != previousState) {
-        Serial.println(stateNames[state]);
-        previousState = state;
-    } 
-
-    switch (state) {
-        case SETUP_RAISE:
-        // Raise the arm from its zeroed position then open gripper.
-        blueMotor.startMoveTo(LIFTER_45ROOF * GEAR_RATIO_LIFTER);
-        blueMotor.loopController();
-        if (blueMotor.pullOnTarget()) {
-            Serial.println("Lifter arm movement complete");
-            blueMotor.setEffort(0);
-            servo.Write(GRIPPER_OPEN);
-            state = CONFIRM_SETUP;
-        }
-        break;
-
-        case CONFIRM_SETUP:
-        // Wait for confirmation from user that robot is properly placed
-        static int tempCount1 = 0;
-        if(tempCount1 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount1++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
+void lifterTask() {
+    if(estop.isTripped()) blueMotor.setEffort(0);
+    else if(blueMotor.isAutoTuning()) {
+        blueMotor.loopAutoTune(frame);
+        if(!blueMotor.isAutoTuning() && blueMotor.isTuned()) { // Finished: keep the new gains across power cycles
+            const uint8_t params[] = {Calibration::LIFTER_KP, Calibration::LIFTER_KI, Calibration::LIFTER_KD};
+            const float gains[] = {blueMotor.pullGain(1), blueMotor.pullGain(2), blueMotor.pullGain(3)};
+            calibration.set(params, gains, 3);
+            Serial.println(calibration.save() ? "  || Auto-tune gains saved" : "  || Auto-tune gains not saved: EEPROM write failed");
         }
+    }
+    else if(blueMotor.isScanning()) {
+        blueMotor.loopGravityScan(frame);
+        if(!blueMotor.isScanning()) finishGravityScan();
+    }
+    else if(!tweak) blueMotor.loopController(frame);
+}
 
-        if(!paused) state = GRIPPING_1;
-        break;
-
-        case GRIPPING_1:
-        // Close gripper on existing plate for removal
-        servo.Write(GRIPPER_CLOSED);
-        state = CONFIRM_1;
-        break;
-        
-        case CONFIRM_1:
-        // Wait for confirmation from user that plate is securely gripped
-        static int tempCount2 = 0;
-        if(tempCount2 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount2++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
-        }
+/**
+ * Read every sensor once for this tick. Runs before the control tasks, which all
+ * work from `frame` instead of reading the hardware themselves.
+ */
+void sensorTask() {
+    frame.micros = micros();
+    blueMotor.sample(frame);
+    rangeFinder.sample(frame);
+    lineSensor.sample(frame);
+    chassis.updateOdometry();
+}
 
-        if(!paused) {
-            //chassis.startUltraDrive(DIST_ROOF, rangeFinder.getDistance());
-            chassis.setEfforts(-75, -75);
-            state = DRIVE_REV_LOWER_1;
-        }
-        break;
-
-        case DRIVE_REV_LOWER_1:
-        // Ultrasonic and drive in reverse until intersection, also lower arm to platform height
-        //chassis.loopUltraPID(rangeFinder.getDistance());
-        Serial.print("Dist: ");
-        Serial.println(rangeFinder.getDistance());
-        
-        static bool delayFlag = false;
-        if(rangeFinder.getDistance() >= DIST_ROOF+2.35) {
-            Serial.println("Chassis target reached");
-            chassis.drive(0);
-            delayFlag = true;
-        }
+/**
+ * Called by the line sensor as the robot enters each intersection
+ */
+void onIntersection(uint16_t count) {
+    Serial.print("  || Intersection: ");
+    Serial.println(count);
+}
 
-        if(delayFlag) blueMotor.startMoveTo(LIFTER_PLATFORM * GEAR_RATIO_LIFTER);
-        if(delayFlag) blueMotor.loopController();
-        if (delayFlag && blueMotor.pullOnTarget()) {
-            Serial.println("Lifter arm movement complete");
-            blueMotor.setEffort(0);
-        }
-        /*if(chassis.pullOnTarget(rangeFinder.getDistance())) {
-            chassis.drive(0);
-            Serial.println("Chassis target reached");
-        }*/
-        
-        if(rangeFinder.getDistance() >= DIST_ROOF+2.35/*chassis.pullOnTarget(rangeFinder.getDistance())*/ && blueMotor.pullOnTarget()) {
-            Serial.println("both complete");
-            state = TURN_LEFT_1;
-            chassis.startTurn(79);
-        }
-        break;
-
-        case TURN_LEFT_1:                           // This is actually turn RIGHT lol. I'll change later...?
-        // Turn right 90 degrees to face platform
-        if(chassis.turnComplete()) {
-            Serial.println("Turn 90 left complete");
-            chassis.drive(0);
-            state = DRIVE_FWD_PLATFORM;
-            delay(1000);
-            chassis.setEfforts(70,75);
-            //chassis.startUltraDrive(2.5, rangeFinder.getDistance());
-        }
-        break;
-
-        case DRIVE_FWD_PLATFORM:
-        // Drive to platform with linefollow/ultrasonic/both
-        //chassis.loopUltraPID(rangeFinder.getDistance());
-        if(rangeFinder.getDistance() <= 2.25) {
-        //if(chassis.pullOnTarget(rangeFinder.getDistance())) {
-            Serial.println("Chassis target reached");
-            chassis.drive(0);
-            state = CONFIRM_2;
-        }
-        break;
-
-        case CONFIRM_2:
-        // Wait for confirmation from user that plate is placed on platform
-        static int tempCount3 = 0;
-        if(tempCount3 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount3++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
-        }
+/**
+ * End of the remote 8 spin: offer the measured line sensor ranges for "cal save"
+ */
+void finishLineCalibration() {
+    if(!lineSensor.finishCalibration()) {
+        Serial.println("  || Line calibration failed: a sensor never crossed the tape");
+        return;
+    }
+    const uint8_t params[] = {Calibration::LINE_LEFT_MIN, Calibration::LINE_LEFT_MAX,
+                              Calibration::LINE_RIGHT_MIN, Calibration::LINE_RIGHT_MAX};
+    const float ranges[] = {(float)lineSensor.pullMin(true), (float)lineSensor.pullMax(true),
+                            (float)lineSensor.pullMin(false), (float)lineSensor.pullMax(false)};
+    calibration.set(params, ranges, 4);
+    Serial.println("  || Line calibration done (cal save to keep it)");
+}
 
-        if(!paused) state = RELEASE_1;
-        break;
-
-        case RELEASE_1:
-        // Open gripper to place plate on platform
-        servo.Write(GRIPPER_OPEN);
-        state = CONFIRM_3;
-        break;
-
-        case CONFIRM_3:
-        // Wait for confirmation from user that old plate is removed and new plate is on platform
-        static int tempCount4 = 0;
-        if(tempCount4 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount4++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
-        }
+void chassisTask() {
+    if(estop.isTripped()) chassis.drive(0);
+    else if(chassis.isUltraDriving()) {
+        if(frame.rangeFresh) chassis.loopUltraPID(frame.range);
+        else chassis.drive(0); // Hold still until the rangefinder recovers
+    }
+    else if(chassis.isTurning()) {
+        chassis.loopTurn();
+        if(chassis.turnComplete() && lineSensor.isCalibrating()) finishLineCalibration();
+    }
+    else if(chassis.isLineFollowing()) chassis.loopLineFollow(frame.lineOffset, frame.lineConfidence);
+    else if(chassis.isVelocityControlled()) chassis.loopVelocity();
+}
 
-        if(!paused) state = GRIPPING_2;
-        break;
-
-        case GRIPPING_2:
-        // Close gripper on new plate
-        servo.Write(GRIPPER_CLOSED);
-        delay(250);
-        state = DRIVE_REV_LIFT_1;
-        chassis.setEfforts(-68, -75);
-        break;
-
-        case DRIVE_REV_LIFT_1:
-        // Line follow and drive in reverse until intersection, also raise arm to 45 deg roof height
-        if(rangeFinder.getDistance() >= DIST_PLATFORM+6.5) {
-            Serial.println("Chassis target reached.");
-            chassis.drive(0);
-        }
-        blueMotor.startMoveTo(LIFTER_45ROOF * GEAR_RATIO_LIFTER);
-        blueMotor.loopController();
-        if (blueMotor.pullOnTarget()) {
-            Serial.println("Lifter arm movement complete");
-            blueMotor.setEffort(0);
-            state = TURN_RIGHT_1;
-            chassis.startTurn(-85);
-        }
-        break;
-
-        case TURN_RIGHT_1:                          // This is actually turn LEFT lmfao, same thing as above.
-        // Turn left 90 degrees to face roof
-        if(chassis.turnComplete()) {
-            Serial.println("Turn 90 left complete");
-            chassis.drive(0);
-            state = DRIVE_FWD_ROOF;
-            delay(500);
-            chassis.setEfforts(67, 75);
-        }
-        break;
-
-        case DRIVE_FWD_ROOF:
-        // Drive to roof with linefollow/ultrasonic/both
-        if(rangeFinder.getDistance() <= 4.84) {
-            Serial.println("Chassis target reached.");
-            chassis.drive(0);
-            state = CONFIRM_DEPOSIT;
-        }
-        break;
-
-        case CONFIRM_DEPOSIT:
-        // Wait for confirmation from user that plate is alligned with roof
-        static int tempCount5 = 0;
-        if(tempCount5 == 0) {
-            Serial.print("Awaiting user confirmation");
-            paused = true;
-            tempCount5++;
-            if(skip_ir) {
-                delay(5000);
-                paused = false;
-            }
-        }
+void telemetryTask() {
+    telemetry.loop();
+}
 
-        if(!paused) state = RELEASE_2;
-        break;
-
-        case RELEASE_2:
-        // Open gripper to place plate on 25 deg roof and back up to line again
-        servo.Write(GRIPPER_OPEN);
-        static int tempCount6 = 0;
-        if(tempCount6 == 0) {
-            delay(500);
-            chassis.setEfforts(-75,-75);
-            tempCount6++;
-        }
-        if(rangeFinder.getDistance() >= DIST_ROOF) {
-            Serial.println("Chassis target reached.");
-            chassis.drive(0);
-            state = IDLE;
-        }
-        break;
+void missionTask() {
+    if(estop.isTripped()) return;
+    if(blueMotor.isScanning()) return; // A lift step would take the lifter away from the scan
+    if(TESTING) {
+        testSequence();
+        return;
+    }
+    if(!mission.isStarted()) mission.start(AUTO_2 ? ROOF_45 : ROOF_25); // Remote 7 selects the 45-degree roof
+    mission.loop(frame);
+}
 
-        case IDLE:
-        Serial.println("Autonomous sequence complete.");
-        break;
+/**
+ * Runs in the scheduler's tick interrupt, so the E-stop reacts within a tick
+ * even while a task is blocked
+ */
+void estopTick() {
+    estop.poll();
+}
 
-        case STOPPED:
-        paused = true;
-        break;
+/**
+ * Push the calibration values that other objects keep their own copy of. Only
+ * the object that uses a changed value is touched, so e.g. a DIST_ROOF change
+ * mid-lift leaves the lifter controller alone.
+ * @param param The value that changed, or Calibration::NONE for all of them
+ */
+void applyCalibration(uint8_t param) {
+    bool all = param == Calibration::NONE;
+    if(all || param == Calibration::GRIPPER_CLOSED || param == Calibration::GRIPPER_OPEN) {
+        servo.SetMinMaxUS(calibration.get(Calibration::GRIPPER_CLOSED), calibration.get(Calibration::GRIPPER_OPEN));
+    }
+    if(all || param == Calibration::LIFTER_KP || param == Calibration::LIFTER_KI || param == Calibration::LIFTER_KD) {
+        blueMotor.setGains(calibration.get(Calibration::LIFTER_KP), calibration.get(Calibration::LIFTER_KI),
+                           calibration.get(Calibration::LIFTER_KD));
+    }
+    for(uint8_t i = 0; i < BlueMotor::GRAVITY_POINTS; i++) {
+        if(all || param == Calibration::LIFTER_GRAVITY_0 + i) blueMotor.setGravity(i, calibration.get(Calibration::LIFTER_GRAVITY_0 + i));
+    }
+    if(all || param == Calibration::LINE_LEFT_MIN || param == Calibration::LINE_LEFT_MAX) {
+        lineSensor.setRange(true, calibration.get(Calibration::LINE_LEFT_MIN), calibration.get(Calibration::LINE_LEFT_MAX));
+    }
+    if(all || param == Calibration::LINE_RIGHT_MIN || param == Calibration::LINE_RIGHT_MAX) {
+        lineSensor.setRange(false, calibration.get(Calibration::LINE_RIGHT_MIN), calibration.get(Calibration::LINE_RIGHT_MAX));
+    }
+}
+
+/**
+ * Serial commands other than "cal":
+ *
+ *   timing                print the loop and task timing histograms (-DTIMING_PROBES)
+ *   timing reset          empty them, and the worst-case task runtimes
+ */
+void serialCommand(const char *command, const char *argument) {
+    if (strcmp(command, "timing")) return;
+    if (argument && !strcmp(argument, "reset")) {
+        scheduler.resetTiming();
+        Serial.println("  || Timing reset");
+    } else {
+        scheduler.printTiming();
     }
 }
 
@@ -627,10 +426,15 @@ void autoSequence2() {
  * Set up the various subsystems.
  */
 void setup() {
-    Serial.begin(9600);
+    Serial.begin(115200);
+    telemetry.setEnabled(TELEMETRY);
     Serial.println("Beginning Program");
+    calibration.load(CALIBRATION_DEFAULTS);
+    calibration.setListener(applyCalibration);
+    calibration.setCommandHandler(serialCommand);
 
     decoder.init();
+    estop.setup(decoder, remotePlayPause);
 
     blueMotor.setup();
     blueMotor.setEffort(0);
@@ -638,39 +442,48 @@ void setup() {
 
     servo.Init();
     servo.Attach();
-    servo.SetMinMaxUS(GRIPPER_CLOSED, GRIPPER_OPEN);
+    applyCalibration(Calibration::NONE);
     pinMode(18, INPUT);
-    servo.Write(GRIPPER_CLOSED); // Start the gripper closed.
+    servo.Write(calibration.get(Calibration::GRIPPER_CLOSED)); // Start the gripper closed.
 
     rangeFinder.setup();
     lineSensor.setup();
+    lineSensor.setIntersectionListener(onIntersection);
     chassis.setup();
 
-    state = SETUP_RAISE;
+    if(BENCHMARK) benchmark.run(blueMotor);
+
+    mission.setAutoConfirm(skip_ir);
 
-    while(!pushButton.isPressed()) delay(10); // Wait for button to start
-    if(TESTING) chassis.startUltraDrive(DIST_ROOF, rangeFinder.getDistance());
+    // Start the tick first: keys pressed while waiting (e.g. 7 for the 45-degree roof)
+    // queue up as events and are handled before the mission task first runs
+    scheduler.setup();
+    scheduler.setTickHook(estopTick);
+
+    while(!pushButton.isPressed()) { // Wait for button to start; calibration can be edited meanwhile
+        calibration.loop();
+        delay(10);
+    }
+    if(TESTING) chassis.startUltraDrive(calibration.get(Calibration::DIST_ROOF), rangeFinder.getDistance());
+
+    scheduler.addTask("events", eventTask, 10, 0);
+    scheduler.addTask("sensors", sensorTask, 10, 1);
+    scheduler.addTask("remote", remoteTask, 20, 2);
+    scheduler.addTask("lifter", lifterTask, 10, 3);
+    scheduler.addTask("chassis", chassisTask, 10, 4);
+    scheduler.addTask("range", rangeTask, 60, 5);
+    scheduler.addTask("mission", missionTask, 10, 6);
+    scheduler.addTask("telemetry", telemetryTask, 10, 7);
+    printMemory();
 }
 
 /** 
- * Core loop of the controller, runs remote check and then the main sequencing/functions.
- * Note that the runtime/latency of any functions here will inhibit the latency of the remote functionality,
- * namely the E-Stop feature (which isn't an E-Stop if its not instantaneous).
+ * Core loop of the controller. Everything runs as a scheduled task (see setup()), so
+ * remote keys are handled within 10ms regardless of what the sequence is doing; the
+ * E-Stop itself is checked every tick from interrupt context (see estopTick()). Press 0 on the remote to print task timing (with timing
+ * histograms if built with -DTIMING_PROBES).
  */
 void loop() {
-  
-  checkRemote();
-  rangeFinder.loop();
-  
-  if(paused) {
-      //Serial.print("Code paused. Last state: ");
-      //Serial.println(stateNames[state]);
-      
-      chassis.drive(0);     // Turn off all motors
-      blueMotor.setEffort(0);
-  } else {
-      // Run main sequencing
-      if(!TESTING && !AUTO_2) autoSequence1(); else if(!TESTING && AUTO_2) autoSequence2(); else testSequence();
-      //autoSequence1();
-  }
+    scheduler.markLoop();
+    scheduler.run();
 }
\ No newline at end of file
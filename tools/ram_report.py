@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+Show where the firmware's flash and static RAM go, per translation unit.
+
+    pio run -e a-star32U4
+    python3 tools/ram_report.py                     # biggest .data + .bss first
+    python3 tools/ram_report.py --sort text         # or by flash
+    python3 tools/ram_report.py --all               # include library and core objects
+
+.data and .bss are fixed at link time and sit at the bottom of the 32U4's 2.5 KB
+of SRAM; whatever is left is shared by the heap and the stack. Per-object sizes
+are before the linker drops unused sections, so they can add up to more than the
+totals from firmware.elf, which are exact. At run time, remote 0 prints the
+stack's actual headroom (halStackUnused()).
+"""
+
+import argparse
+import glob
+import os
+import shutil
+import subprocess
+import sys
+
+SRAM_BYTES = 2560       # ATmega32U4
+FLASH_BYTES = 28672     # 32 KB less the 4 KB bootloader
+
+
+def find_size_tool(name):
+    if shutil.which(name):
+        return name
+    pio = os.path.expanduser("~/.platformio/packages/toolchain-atmelavr/bin/" + name)
+    if os.path.exists(pio):
+        return pio
+    sys.exit("%s not found; pass --size-tool" % name)
+
+
+def sizes(tool, paths):
+    """Berkeley-format sizes: {path: (text, data, bss)}"""
+    out = subprocess.run([tool] + paths, stdout=subprocess.PIPE, universal_newlines=True, check=True).stdout
+    result = {}
+    for line in out.splitlines()[1:]:
+        fields = line.split(None, 5)
+        if len(fields) == 6:
+            result[fields[5]] = tuple(int(f) for f in fields[:3])
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--build-dir", default=".pio/build/a-star32U4")
+    parser.add_argument("--size-tool", default="avr-size")
+    parser.add_argument("--sort", choices=["ram", "text"], default="ram")
+    parser.add_argument("--all", action="store_true", help="list library and core objects too")
+    opts = parser.parse_args()
+
+    tool = find_size_tool(opts.size_tool)
+    objects = sorted(glob.glob(os.path.join(opts.build_dir, "**", "*.o"), recursive=True))
+    if not objects:
+        sys.exit("no object files under %s; build first" % opts.build_dir)
+    if not opts.all:
+        objects = [o for o in objects if os.sep + "src" + os.sep in o] or objects
+
+    rows = sizes(tool, objects)
+    key = (lambda r: r[1][1] + r[1][2]) if opts.sort == "ram" else (lambda r: r[1][0])
+    print("%-36s %7s %7s %7s" % ("object", ".text", ".data", ".bss"))
+    for path, (text, data, bss) in sorted(rows.items(), key=key, reverse=True):
+        print("%-36s %7d %7d %7d" % (os.path.relpath(path, opts.build_dir), text, data, bss))
+    print("%-36s %7d %7d %7d" % ("(sum of the above)", *[sum(r[i] for r in rows.values()) for i in range(3)]))
+
+    elf = os.path.join(opts.build_dir, "firmware.elf")
+    if os.path.exists(elf):
+        text, data, bss = sizes(tool, [elf])[elf]
+        static = data + bss
+        print()
+        print("firmware.elf")
+        print("  flash  %6d of %d (%.0f%%)" % (text + data, FLASH_BYTES, 100.0 * (text + data) / FLASH_BYTES))
+        print("  SRAM   %6d of %d static (.data %d + .bss %d), %d left for heap and stack" % (
+            static, SRAM_BYTES, data, bss, SRAM_BYTES - static))
+
+
+if __name__ == "__main__":
+    main()
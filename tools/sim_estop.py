@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""
+Check the E-stop latch in the native simulator with the PlayPause key held down.
+
+    pio run -e native
+    python3 tools/sim_estop.py
+    python3 tools/sim_estop.py --at 12000 --hold 3000
+
+A held NEC key repeats about every 110 ms. Each case presses the stop key at
+--at ms into mission 1 and holds it for --hold ms:
+
+  held          nothing else; the robot must stay stopped to the end of the run
+  pressed again released, then pressed once more; the robot must run again and
+                finish the mission
+
+Exits non-zero if any case fails.
+"""
+
+import argparse
+import subprocess
+import sys
+
+STOP_KEY = 0x01         # remotePlayPause
+REPRESS_GAP_MS = 1000   # From release to the second press
+
+
+def run(program, args):
+    out = subprocess.run([program] + args, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    return dict(line.split("=", 1) for line in out.splitlines() if "=" in line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--program", default=".pio/build/native/program")
+    parser.add_argument("--at", type=int, default=25000, help="when the stop key goes down, ms")
+    parser.add_argument("--hold", type=int, default=2000, help="how long it is held, ms")
+    opts = parser.parse_args()
+
+    press = "%d:%d:%d" % (opts.at, STOP_KEY, opts.hold)
+    again = "%d:%d" % (opts.at + opts.hold + REPRESS_GAP_MS, STOP_KEY)
+    failures = 0
+
+    held = run(opts.program, ["--key", press, "--limit", str(opts.at / 1000.0 + 15)])
+    ok = "stop_latency_us" in held and "restart_after_stop_ms" not in held
+    print("held:          %s  stop_latency_us=%s restart_after_stop_ms=%s" % (
+        "ok  " if ok else "FAIL", held.get("stop_latency_us", "-"), held.get("restart_after_stop_ms", "-")))
+    failures += not ok
+
+    resumed = run(opts.program, ["--key", press, "--key", again])
+    restart = int(resumed.get("restart_after_stop_ms", -1))
+    ok = resumed.get("completed") == "1" and restart >= opts.hold + REPRESS_GAP_MS
+    print("pressed again: %s  restart_after_stop_ms=%d completed=%s" % (
+        "ok  " if ok else "FAIL", restart, resumed.get("completed", "-")))
+    failures += not ok
+
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+Run the native simulator over many seeds and summarise where the missions end.
+
+    pio run -e native
+    python3 tools/sim_sweep.py                      # 200 runs of each roof, plant scattered
+    python3 tools/sim_sweep.py --runs 500 --mission 2 --vary 2 --csv runs.csv
+    python3 tools/sim_sweep.py -- --range-glitch 0.1   # extra arguments for every run
+
+Each run gets its own --seed, so any outlier can be replayed on its own with
+`--seed <n> --vary <scale> --echo`. Runs go to every core in parallel. Exits
+non-zero if any run failed to complete.
+"""
+
+import argparse
+import csv
+import os
+import statistics
+import subprocess
+import sys
+from concurrent.futures import ThreadPoolExecutor
+
+FIELDS = ["sim_time_s", "pose_x_in", "pose_y_in", "pose_heading_deg", "lifter_arm_deg", "range_in"]
+
+
+def run(program, mission, seed, vary, extra):
+    args = [program, "--seed", str(seed), "--vary", str(vary)] + extra
+    if mission == 2:
+        args.append("--auto2")
+    out = subprocess.run(args, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    result = dict(line.split("=", 1) for line in out.splitlines() if "=" in line)
+    result["mission"] = mission
+    result["seed"] = seed
+    return result
+
+
+def summarise(mission, results):
+    done = [r for r in results if r.get("completed") == "1"]
+    print("mission %d: %d/%d completed" % (mission, len(done), len(results)))
+    if done:
+        print("  %-18s %9s %9s %9s %9s" % ("", "mean", "stdev", "min", "max"))
+        for field in FIELDS:
+            values = [float(r[field]) for r in done]
+            print("  %-18s %9.2f %9.2f %9.2f %9.2f" % (
+                field, statistics.mean(values), statistics.pstdev(values), min(values), max(values)))
+    failed = [r["seed"] for r in results if r.get("completed") != "1"]
+    if failed:
+        print("  failed seeds: %s" % " ".join(str(s) for s in failed))
+    speedups = [float(r["speedup"]) for r in results if "speedup" in r]
+    if speedups:
+        print("  speedup over real time: %.0fx median" % statistics.median(speedups))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--program", default=".pio/build/native/program")
+    parser.add_argument("--runs", type=int, default=200, help="runs per mission")
+    parser.add_argument("--mission", type=int, choices=[1, 2], help="only this roof")
+    parser.add_argument("--vary", type=float, default=1.0, help="plant scatter, in typical tolerances")
+    parser.add_argument("--csv", help="also write every run to this file")
+    parser.add_argument("extra", nargs="*", help="passed through to the simulator (after --)")
+    opts = parser.parse_args()
+
+    missions = [opts.mission] if opts.mission else [1, 2]
+    jobs = [(m, seed) for m in missions for seed in range(1, opts.runs + 1)]
+    with ThreadPoolExecutor(max_workers=os.cpu_count()) as pool:
+        results = list(pool.map(lambda job: run(opts.program, job[0], job[1], opts.vary, opts.extra), jobs))
+
+    for m in missions:
+        summarise(m, [r for r in results if r["mission"] == m])
+
+    if opts.csv:
+        with open(opts.csv, "w", newline="") as f:
+            writer = csv.DictWriter(f, fieldnames=["mission", "seed", "completed"] + FIELDS, extrasaction="ignore")
+            writer.writeheader()
+            writer.writerows(results)
+
+    sys.exit(0 if all(r.get("completed") == "1" for r in results) else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""
+Decode the robot's binary telemetry stream (src/Telemetry.h) to CSV.
+
+    python3 tools/telemetry_decode.py capture.bin > run.csv
+
+Live from the robot (Linux):
+
+    stty -F /dev/ttyACM0 raw 115200
+    python3 tools/telemetry_decode.py /dev/ttyACM0 > run.csv
+
+The step column is the mission step group running when the record was sent:
+the index in the mission table (main.cpp ROOF_25 / ROOF_45) of the group's first
+step. Text printed by the firmware between records is skipped. Records with a bad
+checksum are discarded, and gaps in the sequence number are counted as drops;
+both totals go to stderr at the end.
+"""
+
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+# seq, timestamp, step, channel, position, setpoint, output, applied, confidence, kp, ki, kd, checksum
+BODY = struct.Struct("<BIBBfffhBhhhB")
+RECORD_SIZE = len(SYNC) + BODY.size
+CHANNELS = {0: "lifter", 1: "chassis", 2: "line", 3: "line_follow"}
+COLUMNS = ["seq", "time_s", "step", "channel", "position", "setpoint",
+           "output", "applied", "confidence", "kp", "ki", "kd"]
+
+
+def records(stream, stats):
+    buf = b""
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            return
+        buf += chunk
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                buf = buf[-1:]
+                break
+            if len(buf) - start < RECORD_SIZE:
+                buf = buf[start:]
+                break
+            body = buf[start + len(SYNC):start + RECORD_SIZE]
+            if sum(body[:-1]) & 0xFF != body[-1]:
+                stats["bad"] += 1
+                buf = buf[start + 1:]
+                continue
+            buf = buf[start + RECORD_SIZE:]
+            yield BODY.unpack(body)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: telemetry_decode.py <capture file | serial device | ->")
+    stream = sys.stdin.buffer if sys.argv[1] == "-" else open(sys.argv[1], "rb", buffering=0)
+    stats = {"bad": 0, "dropped": 0, "decoded": 0}
+    last_seq = None
+
+    print(",".join(COLUMNS))
+    try:
+        for seq, ts, step, channel, pos, setpoint, out, applied, confidence, kp, ki, kd, _ in records(stream, stats):
+            if last_seq is not None:
+                stats["dropped"] += (seq - last_seq - 1) & 0xFF
+            last_seq = seq
+            stats["decoded"] += 1
+            print("%d,%.6f,%d,%s,%.3f,%.3f,%.3f,%d,%d,%.4f,%.4f,%.4f" % (
+                seq, ts / 1e6, step, CHANNELS.get(channel, channel), pos, setpoint, out,
+                applied, confidence, kp / 1024.0, ki / 1024.0, kd / 1024.0))
+    except KeyboardInterrupt:
+        pass
+
+    print("decoded=%d dropped=%d bad_checksum=%d" % (
+        stats["decoded"], stats["dropped"], stats["bad"]), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()